@@ -1,11 +1,32 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include "uparse.h"
 
-int main(void) {
+// Only uparse.h can be built header-only; the other modules are separate
+// translation units linked against libuparse, so speed_test_header, which
+// links nothing, runs just the benchmarks of the core parser.
+#ifndef UPARSE_IMPLEMENTATION
+#include "uparse_cache.h"
+#include "uparse_route.h"
+#include "uparse_compact.h"
+#include "uparse_psl.h"
+#include "uparse_match.h"
+#include "uparse_extract.h"
+#include "uparse_dict.h"
+#endif
+
+static double seconds_since(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench_parse(void) {
     char const *const url_str = "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom";
     unsigned int fail_count = 0;
     unsigned int url_out_err = 0;
+    clock_t const start = clock();
     for (size_t i = 0; i < 1000000; i++) {
         url_out_err = NO_UPARSE_ERROR;
         url_t *url = parse_url(url_str,&url_out_err);
@@ -15,4 +36,609 @@ int main(void) {
         free_url_t(url);
         url = NULL;
     }
+    printf("parse_url x 1000000: %.3fs (%u failed)\n",seconds_since(start),fail_count);
+}
+
+// Parse real world urls, which legacy rejects, under the other policies.
+static void bench_policy(void) {
+    char const *const url_str = "https://cdn-edge.my-site.example.com/static_v2/app.min.js?v=1.2.3&lang=en-US#top";
+    char const *const names[UPARSE_POLICY_COUNT] = {"legacy","lenient","strict"};
+    for (unsigned int p = UPARSE_POLICY_LENIENT; p < UPARSE_POLICY_COUNT; p++) {
+        unsigned int fail_count = 0;
+        unsigned int err = NO_UPARSE_ERROR;
+        clock_t const start = clock();
+        for (size_t i = 0; i < 1000000; i++) {
+            url_t *url = parse_url_ex(url_str,NULL,(uparse_policy_t) p,&err);
+            if ((NULL == url) || (NO_UPARSE_ERROR != err)) {
+                fail_count++;
+            }
+            if (NULL != url) {
+                free_url_t(url);
+            }
+        }
+        printf("parse_url_ex %s x 1000000: %.3fs (%u failed)\n",names[p],seconds_since(start),fail_count);
+    }
+}
+
+static void bench_path_segments(void) {
+    char const *const path = "/api/v1/users/12345/orders/678/items";
+    uparse_span_t segs[16];
+    size_t total = 0;
+    clock_t const start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        size_t overflow = 0;
+        unsigned int err = NO_UPARSE_ERROR;
+        total += get_path_segments(path,segs,16,&overflow,&err);
+    }
+    printf("get_path_segments x 1000000: %.3fs (%lu segments)\n",seconds_since(start),total);
+}
+
+#define HOST_CORPUS 64
+
+static void bench_corpus(char const *name,char corpus[HOST_CORPUS][96]) {
+    unsigned int err = NO_UPARSE_ERROR;
+    unsigned int fail_count = 0;
+    clock_t const start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        url_t *url = parse_url(corpus[i % HOST_CORPUS],&err);
+        if (NULL == url) {
+            fail_count++;
+            continue;
+        }
+        free_url_t(url);
+    }
+    printf("parse_url %s hosts x 1000000: %.3fs (%u failed)\n",name,seconds_since(start),fail_count);
+}
+
+// Parse the same paths with name, ipv4 and ipv6 hosts, to check that
+// recognizing address literals does not slow down ordinary host names.
+static void bench_hosts(void) {
+    static char names[HOST_CORPUS][96];
+    static char v4[HOST_CORPUS][96];
+    static char v6[HOST_CORPUS][96];
+    for (unsigned int i = 0; i < HOST_CORPUS; i++) {
+        snprintf(names[i],sizeof(names[i]),"http://svc%u.internal.example.com:8080/v1/items/%u",i,i);
+        snprintf(v4[i],sizeof(v4[i]),"http://10.%u.%u.%u:8080/v1/items/%u",i,i * 3,i * 2,i);
+        snprintf(v6[i],sizeof(v6[i]),"http://[2001:db8:%x::%x:%x]:8080/v1/items/%u",i,i * 3,i * 2,i);
+    }
+    bench_corpus("name",names);
+    bench_corpus("ipv4",v4);
+    bench_corpus("ipv6",v6);
+}
+
+// Parse a url that arrives in two chunks, by reassembling it first and by
+// feeding the chunks to the incremental parser.
+static void bench_feed(void) {
+    char const *const url_str = "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom";
+    size_t const len = strlen(url_str);
+    size_t const split = len / 2;
+    unsigned int err = NO_UPARSE_ERROR;
+    char joined[128];
+    clock_t start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        memcpy(joined,url_str,split);
+        memcpy(joined + split,url_str + split,len - split);
+        joined[len] = '\0';
+        free_url_t(parse_url(joined,&err));
+    }
+    printf("reassemble + parse_url x 1000000: %.3fs\n",seconds_since(start));
+    static uparse_feed_t f;
+    start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        size_t used = 0;
+        uparse_feed_init(&f);
+        uparse_feed(&f,url_str,split,&used);
+        uparse_feed(&f,url_str + split,len - split,&used);
+        uparse_feed_finish(&f);
+        free_url_t(uparse_feed_url(&f,&err));
+    }
+    printf("uparse_feed x 1000000: %.3fs\n",seconds_since(start));
+}
+
+// Parse an origin-form request target directly, and by gluing a fake
+// scheme and host onto it.
+static void bench_request_target(void) {
+    char const *const target = "/foo/bar/baz?a=bbb&c=ddddd";
+    unsigned int err = NO_UPARSE_ERROR;
+    uparse_target_form_t form = UPARSE_TARGET_ORIGIN;
+    char glued[128];
+    clock_t start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        snprintf(glued,sizeof(glued),"http://host%s",target);
+        free_url_t(parse_url(glued,&err));
+    }
+    printf("prefix + parse_url x 1000000: %.3fs\n",seconds_since(start));
+    start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        free_url_t(parse_request_target(target,&form,&err));
+    }
+    printf("parse_request_target x 1000000: %.3fs\n",seconds_since(start));
+}
+
+// Rebuild a parsed url with url_format and, for comparison, snprintf.
+static void bench_format(void) {
+    unsigned int err = NO_UPARSE_ERROR;
+    url_t *url = parse_url("https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom",&err);
+    char buf[256];
+    size_t total = 0;
+    clock_t start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        total += url_format(url,buf,sizeof(buf));
+    }
+    printf("url_format x 1000000: %.3fs (%lu bytes)\n",seconds_since(start),total);
+    total = 0;
+    start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        total += (size_t) snprintf(buf,sizeof(buf),"%s://%s:%u%s?%s#%s",url->scheme,url->host,
+                                   url->port,url->path,url->query,url->fragment);
+    }
+    printf("snprintf x 1000000: %.3fs (%lu bytes)\n",seconds_since(start),total);
+    free_url_t(url);
+}
+
+// Resolve a mix of hrefs against one base url.
+static void bench_resolve(void) {
+    char const *const refs[] = {"../img/a.png","?page=2","//cdn.host/x","g/./h/../i","/abs/path#top"};
+    unsigned int err = NO_UPARSE_ERROR;
+    url_t *base = parse_url("https://foo.bar.com/docs/guide/intro?lang=en",&err);
+    char buf[256];
+    size_t total = 0;
+    clock_t const start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        total += url_resolve(base,refs[i % 5],buf,sizeof(buf),&err);
+    }
+    printf("url_resolve x 1000000: %.3fs (%lu bytes)\n",seconds_since(start),total);
+    free_url_t(base);
+}
+
+#ifndef UPARSE_IMPLEMENTATION
+
+#define ROUTE_COUNT 5000
+
+// Match paths against 5000 patterns shaped like a versioned rest api.
+static void bench_router(void) {
+    uparse_router_t *router = uparse_router_new();
+    char pattern[96];
+    unsigned int err = NO_UPARSE_ERROR;
+    for (unsigned int i = 0; i < ROUTE_COUNT; i++) {
+        snprintf(pattern,sizeof(pattern),"/api/v%u/res%u/:id/sub%u",i % 5,i / 50,i % 50);
+        uparse_router_add(router,pattern,i + 1,&err);
+    }
+    uparse_router_compile(router,&err);
+
+    char paths[64][96];
+    for (unsigned int i = 0; i < 64; i++) {
+        unsigned int const r = (i * 7919) % ROUTE_COUNT;
+        snprintf(paths[i],sizeof(paths[i]),"/api/v%u/res%u/%u/sub%u",r % 5,r / 50,i,r % 50);
+    }
+
+    size_t matched = 0;
+    uparse_route_match_t m;
+    clock_t const start = clock();
+    for (size_t i = 0; i < 1000000; i++) {
+        if (uparse_router_match(router,paths[i & 63],&m)) {
+            matched++;
+        }
+    }
+    printf("uparse_router_match x 1000000 over %d routes: %.3fs (%lu matched)\n",
+           ROUTE_COUNT,seconds_since(start),matched);
+    uparse_router_free(router);
+}
+
+// xorshift64, so runs are repeatable
+static unsigned long long rng_state = 88172645463325252ULL;
+
+static double next_uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (double) (rng_state >> 11) / (double) (1ULL << 53);
+}
+
+#define ZIPF_URLS     10000
+#define ZIPF_REQUESTS 1000000
+
+// Parse a Zipf(1) distributed stream of urls with and without a cache.
+static void bench_cache(void) {
+
+    static char urls[ZIPF_URLS][80];
+    static double cdf[ZIPF_URLS];
+    static unsigned int stream[ZIPF_REQUESTS];
+
+    double total = 0.0;
+    for (size_t i = 0; i < ZIPF_URLS; i++) {
+        snprintf(urls[i],sizeof(urls[i]),"https://host%lu.example.com/api/v1/items/%lu?id=%lu&sort=asc",
+                 i % 500,i,i);
+        total += 1.0 / (double) (i + 1);
+        cdf[i] = total;
+    }
+    for (size_t i = 0; i < ZIPF_REQUESTS; i++) {
+        double const r = next_uniform() * total;
+        size_t lo = 0;
+        size_t hi = ZIPF_URLS - 1;
+        while (lo < hi) {
+            size_t const mid = (lo + hi) / 2;
+            if (cdf[mid] < r) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        stream[i] = (unsigned int) lo;
+    }
+
+    unsigned int err = NO_UPARSE_ERROR;
+    clock_t start = clock();
+    for (size_t i = 0; i < ZIPF_REQUESTS; i++) {
+        url_t *url = parse_url(urls[stream[i]],&err);
+        query_arg_list_t *args = get_query_arg_list(url->query,&err);
+        free_arg_list_t(args);
+        free_url_t(url);
+    }
+    printf("zipf uncached x %d: %.3fs\n",ZIPF_REQUESTS,seconds_since(start));
+
+    // A budget that holds under a third of the distinct urls.
+    uparse_cache_t *cache = uparse_cache_new(16,ZIPF_URLS * 100);
+    start = clock();
+    for (size_t i = 0; i < ZIPF_REQUESTS; i++) {
+        char const *const u = urls[stream[i]];
+        uparse_cached_release(uparse_cache_get(cache,u,strlen(u),&err));
+    }
+    double const elapsed = seconds_since(start);
+    uparse_cache_stats_t stats;
+    uparse_cache_stats(cache,&stats);
+    printf("zipf cached   x %d: %.3fs (hits %lu misses %lu evictions %lu bytes %lu)\n",
+           ZIPF_REQUESTS,elapsed,stats.hits,stats.misses,stats.evictions,stats.bytes);
+    uparse_cache_free(cache);
+}
+
+// Hold a crawl frontier of urls as url_t and as compact urls: the bytes
+// asked of malloc (and in how many blocks), and a pass over all the hosts.
+#define FRONTIER_URLS 200000
+
+static size_t owned_len(char const *s) {
+    return (NULL == s) ? 0 : strlen(s) + 1;
+}
+
+static void bench_compact(void) {
+    static url_t *urls[FRONTIER_URLS];
+    static uparse_compact_t *compacts[FRONTIER_URLS];
+    char buf[128];
+    unsigned int err = NO_UPARSE_ERROR;
+    size_t url_bytes = 0;
+    size_t url_blocks = 0;
+    size_t compact_bytes = 0;
+    for (size_t i = 0; i < FRONTIER_URLS; i++) {
+        snprintf(buf,sizeof(buf),"https://host%lu.example.com/articles/%lu/comments?page=%lu",i % 5000,i,i % 7);
+        urls[i] = parse_url(buf,&err);
+        compacts[i] = uparse_compact_from_url(urls[i],&err);
+        // known schemes are not copied
+        url_bytes += sizeof(url_t) + owned_len(urls[i]->host) + owned_len(urls[i]->path) +
+            owned_len(urls[i]->query) + owned_len(urls[i]->fragment);
+        url_blocks += 1 + (NULL != urls[i]->host) + (NULL != urls[i]->path) +
+            (NULL != urls[i]->query) + (NULL != urls[i]->fragment);
+        compact_bytes += uparse_compact_size(compacts[i]);
+    }
+    printf("url_t x %d: %lu bytes in %lu blocks\n",FRONTIER_URLS,url_bytes,url_blocks);
+    printf("uparse_compact_t x %d: %lu bytes in %d blocks\n",FRONTIER_URLS,compact_bytes,FRONTIER_URLS);
+
+    size_t sum = 0;
+    clock_t start = clock();
+    for (size_t pass = 0; pass < 50; pass++) {
+        for (size_t i = 0; i < FRONTIER_URLS; i++) {
+            sum += strlen(urls[i]->host) + urls[i]->port;
+        }
+    }
+    printf("url_t host scan x %d: %.3fs (%lu)\n",50 * FRONTIER_URLS,seconds_since(start),sum);
+    sum = 0;
+    start = clock();
+    for (size_t pass = 0; pass < 50; pass++) {
+        for (size_t i = 0; i < FRONTIER_URLS; i++) {
+            sum += uparse_compact_host(compacts[i]).len + uparse_compact_port(compacts[i]);
+        }
+    }
+    printf("uparse_compact_t host scan x %d: %.3fs (%lu)\n",50 * FRONTIER_URLS,seconds_since(start),sum);
+
+    for (size_t i = 0; i < FRONTIER_URLS; i++) {
+        free_url_t(urls[i]);
+        uparse_compact_free(compacts[i]);
+    }
+
+    // uparse_compact_parse makes one allocation where parse_url makes four.
+    sum = 0;
+    start = clock();
+    for (size_t i = 0; i < FRONTIER_URLS; i++) {
+        snprintf(buf,sizeof(buf),"https://host%lu.example.com/articles/%lu/comments?page=%lu",i % 5000,i,i % 7);
+        url_t *url = parse_url(buf,&err);
+        sum += strlen(url->path);
+        free_url_t(url);
+    }
+    printf("parse_url x %d: %.3fs (%lu)\n",FRONTIER_URLS,seconds_since(start),sum);
+    sum = 0;
+    start = clock();
+    for (size_t i = 0; i < FRONTIER_URLS; i++) {
+        snprintf(buf,sizeof(buf),"https://host%lu.example.com/articles/%lu/comments?page=%lu",i % 5000,i,i % 7);
+        uparse_compact_t *c = uparse_compact_parse(buf,&err);
+        sum += uparse_compact_path(c).len;
+        uparse_compact_free(c);
+    }
+    printf("uparse_compact_parse x %d: %.3fs (%lu)\n",FRONTIER_URLS,seconds_since(start),sum);
+}
+
+// Find the registrable domain of millions of hosts with the system public
+// suffix list, on one thread and on several sharing the same list.
+#define PSL_FILE    "/usr/share/publicsuffix/public_suffix_list.dat"
+#define PSL_HOSTS   4096
+#define PSL_LOOKUPS 2000000
+#define PSL_THREADS 4
+
+typedef struct psl_bench_t {
+    uparse_psl_t const *psl;
+    char               (*hosts)[64];
+    size_t             found;
+} psl_bench_t;
+
+static void *psl_lookups(void *arg) {
+    psl_bench_t *b = (psl_bench_t *) arg;
+    for (size_t i = 0; i < PSL_LOOKUPS; i++) {
+        char const *const h = b->hosts[i % PSL_HOSTS];
+        uparse_span_t const host = {h,strlen(h)};
+        if (NULL != url_registrable_domain(b->psl,host).ptr) {
+            b->found++;
+        }
+    }
+    return NULL;
+}
+
+static void bench_psl(void) {
+    unsigned int err = NO_UPARSE_ERROR;
+    clock_t start = clock();
+    uparse_psl_t *psl = uparse_psl_load(PSL_FILE,&err);
+    if (NULL == psl) {
+        printf("no public suffix list at %s, skipping\n",PSL_FILE);
+        return;
+    }
+    printf("uparse_psl_load %lu rules: %.3fs\n",uparse_psl_rule_count(psl),seconds_since(start));
+
+    static char hosts[PSL_HOSTS][64];
+    char const *const suffixes[] = {"com","co.uk","org","com.au","github.io","de","s3.amazonaws.com","ck"};
+    size_t const suffix_count = sizeof(suffixes)/sizeof(suffixes[0]);
+    for (size_t i = 0; i < PSL_HOSTS; i++) {
+        snprintf(hosts[i],sizeof(hosts[i]),"www%lu.site%lu.%s",i % 3,i,suffixes[i % suffix_count]);
+    }
+
+    psl_bench_t b = {psl,hosts,0};
+    start = clock();
+    psl_lookups(&b);
+    printf("url_registrable_domain x %d: %.3fs (%lu found)\n",PSL_LOOKUPS,seconds_since(start),b.found);
+
+    // clock() adds up the cpu time of all threads.
+    pthread_t threads[PSL_THREADS];
+    psl_bench_t tb[PSL_THREADS];
+    start = clock();
+    for (size_t t = 0; t < PSL_THREADS; t++) {
+        tb[t] = b;
+        tb[t].found = 0;
+        pthread_create(&threads[t],NULL,psl_lookups,&tb[t]);
+    }
+    size_t found = 0;
+    for (size_t t = 0; t < PSL_THREADS; t++) {
+        pthread_join(threads[t],NULL);
+        found += tb[t].found;
+    }
+    printf("url_registrable_domain x %d on %d threads: %.3fs cpu (%lu found)\n",
+           PSL_LOOKUPS * PSL_THREADS,PSL_THREADS,seconds_since(start),found);
+    uparse_psl_free(psl);
+}
+
+// Match urls against a million host, host suffix and host+path rules,
+// most of them on distinct domains that match nothing but look like the
+// rules ("bad700001.com" next to "bad699999.com"), next to the cost of
+// parsing them.
+#define MATCH_RULES   1000000
+#define MATCH_URLS    262144
+#define MATCH_LOOKUPS 2000000
+
+static void bench_match(void) {
+    char buf[128];
+    unsigned int err = NO_UPARSE_ERROR;
+    size_t const bloom_bits[] = {0,10};
+
+    static url_t *urls[MATCH_URLS];
+    for (size_t i = 0; i < MATCH_URLS; i++) {
+        // One in eight hits a rule.
+        if (0 == (i % 8)) {
+            snprintf(buf,sizeof(buf),"http://www.ads%lu.net/img/%lu",(i * 7919) % 200000,i);
+        } else {
+            snprintf(buf,sizeof(buf),"http://www.bad%lu.com/articles/%lu",700000 + ((i * 7919) % 300000),i);
+        }
+        urls[i] = parse_url(buf,&err);
+    }
+
+    clock_t start = clock();
+    for (size_t i = 0; i < MATCH_LOOKUPS; i++) {
+        snprintf(buf,sizeof(buf),"http://www.site%lu.example.com/articles/%lu",i % MATCH_URLS,i % MATCH_URLS);
+        free_url_t(parse_url(buf,&err));
+    }
+    printf("parse_url for comparison x %d: %.3fs\n",MATCH_LOOKUPS,seconds_since(start));
+
+    for (size_t b = 0; b < 2; b++) {
+        uparse_matcher_t *m = uparse_matcher_new();
+        start = clock();
+        for (size_t i = 0; i < MATCH_RULES; i++) {
+            if (i < 700000) {
+                snprintf(buf,sizeof(buf),"bad%lu.com",i);
+            } else if (i < 900000) {
+                snprintf(buf,sizeof(buf),"*.ads%lu.net",i - 700000);
+            } else {
+                snprintf(buf,sizeof(buf),"cdn%lu.org/track/%lu",i,i);
+            }
+            uparse_matcher_add(m,buf,(unsigned int) (i + 1),&err);
+        }
+        uparse_matcher_compile(m,bloom_bits[b],&err);
+        printf("uparse_matcher_compile %d rules (bloom bits %lu): %.3fs, %lu bytes\n",
+               MATCH_RULES,bloom_bits[b],seconds_since(start),uparse_matcher_bytes(m));
+
+        size_t hits = 0;
+        start = clock();
+        for (size_t i = 0; i < MATCH_LOOKUPS; i++) {
+            if (NO_MATCH_ID != uparse_matcher_match_url(m,urls[i % MATCH_URLS])) {
+                hits++;
+            }
+        }
+        printf("uparse_matcher_match_url x %d (bloom bits %lu): %.3fs (%lu hits)\n",
+               MATCH_LOOKUPS,bloom_bits[b],seconds_since(start),hits);
+        uparse_matcher_free(m);
+    }
+
+    for (size_t i = 0; i < MATCH_URLS; i++) {
+        free_url_t(urls[i]);
+    }
+}
+
+// Find the urls in 64MB of prose with a url every 16KB or so and some
+// other ':'s ("at 10:30: see"), as in logs, mail or crawled pages.
+#define EXTRACT_TEXT_LEN (64 * 1024 * 1024)
+#define EXTRACT_PASSES   4
+
+static void bench_extract(void) {
+    char *text = malloc(EXTRACT_TEXT_LEN);
+    if (NULL == text) {
+        return;
+    }
+    char const *const words[] = {"the ","url ","parser ","at 10:30: ","read ","a ","buffer, ","and ",
+                                 "found\n","nothing. "};
+    size_t len = 0;
+    size_t planted = 0;
+    size_t w = 0;
+    char buf[128];
+    while (len + sizeof(buf) < EXTRACT_TEXT_LEN) {
+        char const *s = words[(w * 7) % 10];
+        if (0 == (w % 2000)) {
+            snprintf(buf,sizeof(buf),"<a href=\"https://www.host%lu.com/articles/%lu?page=2\">",w % 5000,w);
+            s = buf;
+            planted++;
+        }
+        size_t const n = strlen(s);
+        memcpy(text + len,s,n);
+        len += n;
+        w++;
+    }
+
+    size_t found = 0;
+    size_t sum = 0;
+    clock_t start = clock();
+    for (size_t pass = 0; pass < EXTRACT_PASSES; pass++) {
+        uparse_extract_t x;
+        uparse_found_t f;
+        uparse_extract_init(&x,text,len,UPARSE_POLICY_LENIENT);
+        while (uparse_extract_next(&x,&f)) {
+            found++;
+            sum += f.host.len;
+        }
+    }
+    double const secs = seconds_since(start);
+    printf("uparse_extract_next %lu MB x %d: %.3fs, %.2f GB/s (%lu of %lu urls, %lu)\n",
+           len >> 20,EXTRACT_PASSES,secs,(double) len * EXTRACT_PASSES / secs / 1e9,
+           found,planted * EXTRACT_PASSES,sum);
+
+    // Text of "x://[" without a ']': each '[' only looks as far as an ipv6
+    // literal reaches, not to the end of the text.
+    size_t const open_len = 1 << 20;
+    for (size_t i = 0; i < open_len; i++) {
+        text[i] = "x://["[i % 5];
+    }
+    found = 0;
+    start = clock();
+    uparse_extract_t x;
+    uparse_found_t f;
+    uparse_extract_init(&x,text,open_len,UPARSE_POLICY_LENIENT);
+    while (uparse_extract_next(&x,&f)) {
+        found++;
+    }
+    printf("uparse_extract_next %lu MB of unclosed '[': %.3fs (%lu urls)\n",open_len >> 20,seconds_since(start),found);
+    free(text);
+}
+
+// A crawl frontier of a million urls on 5000 hosts as a dictionary: its
+// size against the url strings, then membership tests and a full walk.
+#define DICT_URLS    1000000
+#define DICT_LOOKUPS 1000000
+
+static void bench_dict(void) {
+    static url_t *urls[DICT_URLS];
+    char buf[128];
+    unsigned int err = NO_UPARSE_ERROR;
+    size_t raw_bytes = 0;
+    for (size_t i = 0; i < DICT_URLS; i++) {
+        snprintf(buf,sizeof(buf),"https://host%zu.example.com/articles/%zu/comments?page=%zu",
+                 (i * 7919) % 5000,i,i % 7);
+        urls[i] = parse_url(buf,&err);
+        raw_bytes += strlen(buf) + 1;
+    }
+
+    clock_t start = clock();
+    uparse_dict_builder_t *b = uparse_dict_builder_new();
+    for (size_t i = 0; i < DICT_URLS; i++) {
+        uparse_dict_builder_add(b,urls[i],&err);
+    }
+    size_t len = 0;
+    char *image = uparse_dict_builder_build(b,&len,&err);
+    uparse_dict_builder_free(b);
+    printf("uparse_dict_builder_build %d urls: %.3fs, %zu bytes (url strings %zu bytes)\n",
+           DICT_URLS,seconds_since(start),len,raw_bytes);
+
+    uparse_dict_t *d = uparse_dict_open_buffer(image,len,&err);
+    size_t hits = 0;
+    start = clock();
+    for (size_t i = 0; i < DICT_LOOKUPS; i++) {
+        // Every other lookup misses on the page.
+        url_t *const url = urls[(i * 104729) % DICT_URLS];
+        unsigned int const port = url->port;
+        url->port = (0 == (i % 2)) ? 0 : 8080;
+        if (uparse_dict_contains(d,url)) {
+            hits++;
+        }
+        url->port = port;
+    }
+    printf("uparse_dict_contains x %d: %.3fs (%zu hits)\n",DICT_LOOKUPS,seconds_since(start),hits);
+
+    static uparse_dict_iter_t it;
+    uparse_dict_url_t u;
+    size_t sum = 0;
+    start = clock();
+    uparse_dict_iter_init(&it,d,(uparse_span_t) {NULL,0});
+    while (uparse_dict_iter_next(&it,&u)) {
+        sum += u.path.len;
+    }
+    printf("uparse_dict_iter_next x %zu: %.3fs (%zu)\n",uparse_dict_url_count(d),seconds_since(start),sum);
+
+    uparse_dict_close(d);
+    free(image);
+    for (size_t i = 0; i < DICT_URLS; i++) {
+        free_url_t(urls[i]);
+    }
+}
+
+#endif
+
+int main(void) {
+    bench_parse();
+    bench_policy();
+    bench_hosts();
+    bench_feed();
+    bench_request_target();
+    bench_path_segments();
+    bench_format();
+    bench_resolve();
+#ifndef UPARSE_IMPLEMENTATION
+    bench_router();
+    bench_cache();
+    bench_compact();
+    bench_psl();
+    bench_match();
+    bench_extract();
+    bench_dict();
+#endif
+    return EXIT_SUCCESS;
 }
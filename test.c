@@ -1,6 +1,15 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 #include "uparse.h"
+#include "uparse_cache.h"
+#include "uparse_route.h"
+#include "uparse_compact.h"
+#include "uparse_psl.h"
+#include "uparse_match.h"
+#include "uparse_extract.h"
+#include "uparse_dict.h"
 
 int test_url(const char *const url_str) {
 
@@ -19,8 +28,1586 @@ int test_url(const char *const url_str) {
     return EXIT_SUCCESS;
 }
 
+int test_scheme(void) {
+
+    struct {
+        char const      *url;
+        uparse_scheme_t kind;
+        char const      *scheme;
+        unsigned int    default_port;
+    } cases[] = {
+        {"http://foo.com",UPARSE_SCHEME_HTTP,"http",80},
+        {"HTTPS://foo.com",UPARSE_SCHEME_HTTPS,"https",443},
+        {"wss://foo.com",UPARSE_SCHEME_WSS,"wss",443},
+        {"file:///",UPARSE_SCHEME_UNKNOWN,NULL,0},
+        {"sftp://foo.com",UPARSE_SCHEME_SFTP,"sftp",22},
+        {"ftps://foo.com",UPARSE_SCHEME_FTPS,"ftps",990},
+        {"htp://foo.com",UPARSE_SCHEME_UNKNOWN,"htp",0},
+        {"Gopherx://foo.com",UPARSE_SCHEME_UNKNOWN,"gopherx",0},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        url_t *url = parse_url(cases[i].url,&err);
+        if (NULL == cases[i].scheme) {
+            // file:/// has no host, so does not parse.
+            if (NULL != url) {
+                fprintf(stderr,"%s should not parse\n",cases[i].url);
+                free_url_t(url);
+                result = EXIT_FAILURE;
+            }
+            continue;
+        }
+        if ((NULL == url) ||
+            (cases[i].kind != url->scheme_kind) ||
+            (cases[i].default_port != url->default_port) ||
+            (0 != strcmp(cases[i].scheme,url->scheme))) {
+            fprintf(stderr,"wrong scheme for %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+        } else {
+            printf("%s -> %s (%u)\n",cases[i].url,url->scheme,url->default_port);
+        }
+        if (NULL != url) {
+            free_url_t(url);
+        }
+    }
+    return result;
+}
+
+int test_path_segments(void) {
+
+    struct {
+        char const   *path;
+        size_t       count;
+        char const   *joined;
+        unsigned int err;
+    } cases[] = {
+        {"/foo/bar/baz",3,"foo,bar,baz",NO_UPARSE_ERROR},
+        {"/",0,"",NO_UPARSE_ERROR},
+        {"",0,"",NO_UPARSE_ERROR},
+        {"/a//b/",4,"a,,b,",NO_UPARSE_ERROR},
+        {"/a/b?x=1#c",2,"a,b",NO_UPARSE_ERROR},
+        {"/a/b|c",0,"",UPARSE_ERROR},
+        {"a/b",0,"",UPARSE_ERROR},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        uparse_span_t segs[2];
+        size_t overflow = 0;
+        unsigned int err = NO_UPARSE_ERROR;
+        size_t const n = get_path_segments(cases[i].path,segs,2,&overflow,&err);
+
+        // Join the segments seen by the iterator to check every one of them.
+        char joined[64] = "";
+        size_t iter_count = 0;
+        uparse_path_iter_t iter;
+        uparse_span_t seg;
+        unsigned int iter_err = NO_UPARSE_ERROR;
+        uparse_path_iter_init(&iter,cases[i].path);
+        while (uparse_path_iter_next(&iter,&seg,&iter_err)) {
+            if (0 != iter_count++) {
+                strcat(joined,",");
+            }
+            strncat(joined,seg.ptr,seg.len);
+        }
+
+        printf("%s -> %lu + %lu segments [%s]\n",cases[i].path,n,overflow,joined);
+        if ((cases[i].err != err) || (cases[i].err != iter_err) ||
+            ((NO_UPARSE_ERROR == err) &&
+             (((n + overflow) != cases[i].count) || (iter_count != cases[i].count) ||
+              (0 != strcmp(joined,cases[i].joined))))) {
+            fprintf(stderr,"wrong segments for %s\n",cases[i].path);
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
+
+int test_router(void) {
+
+    char const *const patterns[] = {
+        "/",
+        "/api/v1/users",
+        "/api/v1/users/:id",
+        "/api/v1/users/:id/orders",
+        "/api/v1/users/me/orders",
+        "/api/v2/:kind/:id",
+        "/static/*rest",
+        "/a/b/c/d",
+    };
+
+    uparse_router_t *router = uparse_router_new();
+    if (NULL == router) {
+        fprintf(stderr,"cannot make router\n");
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    unsigned int err = NO_UPARSE_ERROR;
+    for (size_t i = 0; i < sizeof(patterns)/sizeof(char *); i++) {
+        if (!uparse_router_add(router,patterns[i],(unsigned int) (i + 1),&err)) {
+            fprintf(stderr,"cannot add %s\n",patterns[i]);
+            result = EXIT_FAILURE;
+        }
+    }
+    if (uparse_router_add(router,"/api/v1/users/:other",99,&err) ||
+        uparse_router_add(router,"/static/*rest/more",99,&err)) {
+        fprintf(stderr,"bad pattern was added\n");
+        result = EXIT_FAILURE;
+    }
+    if (!uparse_router_compile(router,&err)) {
+        fprintf(stderr,"cannot compile router\n");
+        uparse_router_free(router);
+        return EXIT_FAILURE;
+    }
+
+    struct {
+        char const   *path;
+        unsigned int route_id;
+        char const   *joined;
+    } cases[] = {
+        {"/",1,""},
+        {"/api/v1/users",2,""},
+        {"/api/v1/users/42",3,"42"},
+        {"/api/v1/users/42/orders",4,"42"},
+        {"/api/v1/users/me/orders",5,""},
+        {"/api/v1/users/me",3,"me"},
+        {"/api/v2/books/7",6,"books,7"},
+        {"/static/css/site/main",7,"css/site/main"},
+        {"/static",NO_ROUTE_ID,""},
+        {"/a/b/c/d",8,""},
+        {"/a/b/c",NO_ROUTE_ID,""},
+        {"/api/v1/users/42/carts",NO_ROUTE_ID,""},
+    };
+
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        uparse_route_match_t m;
+        bool const matched = uparse_router_match(router,cases[i].path,&m);
+        char joined[64] = "";
+        for (size_t j = 0; j < m.param_count; j++) {
+            if (0 != j) {
+                strcat(joined,",");
+            }
+            strncat(joined,m.params[j].ptr,m.params[j].len);
+        }
+        printf("%s -> route %u [%s]\n",cases[i].path,m.route_id,joined);
+        if ((matched != (NO_ROUTE_ID != cases[i].route_id)) || (cases[i].route_id != m.route_id) ||
+            (0 != strcmp(cases[i].joined,joined))) {
+            fprintf(stderr,"wrong route for %s\n",cases[i].path);
+            result = EXIT_FAILURE;
+        }
+    }
+
+    uparse_router_free(router);
+    return result;
+}
+
+int test_format(void) {
+
+    char const *const urls[] = {
+        "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom",
+        "http://foo.com",
+        "ftp://foo.com/a/",
+        "http://foo.com:8080?a=b",
+    };
+    char const *const expected[] = {
+        "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom",
+        "http://foo.com/",
+        "ftp://foo.com/a/",
+        NULL,
+    };
+
+    int result = EXIT_SUCCESS;
+    char buf[128];
+    for (size_t i = 0; i < sizeof(urls)/sizeof(char *); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        url_t *url = parse_url(urls[i],&err);
+        if (NULL == expected[i]) {
+            if (NULL != url) {
+                free_url_t(url);
+            }
+            continue;
+        }
+        if (NULL == url) {
+            fprintf(stderr,"cannot parse %s\n",urls[i]);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        size_t const len = url_format(url,buf,sizeof(buf));
+        printf("%s -> %s\n",urls[i],buf);
+        if ((len != strlen(expected[i])) || (0 != strcmp(expected[i],buf))) {
+            fprintf(stderr,"wrong format for %s\n",urls[i]);
+            result = EXIT_FAILURE;
+        }
+
+        // Too small a buffer writes nothing but still reports the length.
+        char small[8];
+        if ((len != url_format(url,small,sizeof(small))) || ('\0' != small[0])) {
+            fprintf(stderr,"wrong short format for %s\n",urls[i]);
+            result = EXIT_FAILURE;
+        }
+
+        // And the formatted url parses back to the same thing.
+        url_t *again = parse_url(buf,&err);
+        if ((NULL == again) || (again->port != url->port) || (0 != strcmp(again->path,url->path))) {
+            fprintf(stderr,"%s does not round trip\n",urls[i]);
+            result = EXIT_FAILURE;
+        }
+        if (NULL != again) {
+            free_url_t(again);
+        }
+        free_url_t(url);
+    }
+
+    // Escaping keeps the delimiters that give the components their structure.
+    url_t u;
+    init_url_t(&u);
+    u.scheme = "http";
+    u.host = "foo.com";
+    u.path = "/a b/c+d";
+    u.query = "q=x y&r=1+2";
+    u.fragment = "top!";
+    url_format_ex(&u,buf,sizeof(buf),UPARSE_FORMAT_ESCAPE);
+    printf("%s\n",buf);
+    if (0 != strcmp("http://foo.com/a b/c%2Bd?q=x y&r=1%2B2#top%21",buf)) {
+        fprintf(stderr,"wrong escaped format\n");
+        result = EXIT_FAILURE;
+    }
+
+    // A url parsed from an escaped string keeps its escapes; only a '%'
+    // that starts none is escaped.
+    unsigned int err = NO_UPARSE_ERROR;
+    url_t *escaped = parse_url_ex("http://foo.com/a%20b/c%2Bd?q=%2F&r=100%#x%4",NULL,UPARSE_POLICY_STRICT,&err);
+    if ((NULL == escaped) || (NO_UPARSE_ERROR != err)) {
+        fprintf(stderr,"cannot parse escaped url\n");
+        result = EXIT_FAILURE;
+    } else {
+        size_t const len = url_format_ex(escaped,buf,sizeof(buf),UPARSE_FORMAT_ESCAPE);
+        printf("%s\n",buf);
+        if ((0 != strcmp("http://foo.com/a%20b/c%2Bd?q=%2F&r=100%25#x%254",buf)) || (strlen(buf) != len)) {
+            fprintf(stderr,"escaped url was escaped again\n");
+            result = EXIT_FAILURE;
+        }
+    }
+    if (NULL != escaped) {
+        free_url_t(escaped);
+    }
+    return result;
+}
+
+int test_resolve(void) {
+
+    // The examples of RFC 3986 5.4, with the base path's ";p" dropped since
+    // parse_url does not accept it.
+    char const *const cases[][2] = {
+        {"g:h","g:h"},
+        {"g","http://a/b/c/g"},
+        {"./g","http://a/b/c/g"},
+        {"g/","http://a/b/c/g/"},
+        {"/g","http://a/g"},
+        {"//g","http://g"},
+        {"?y","http://a/b/c/d?y"},
+        {"g?y","http://a/b/c/g?y"},
+        {"#s","http://a/b/c/d?q#s"},
+        {"g#s","http://a/b/c/g#s"},
+        {"g?y#s","http://a/b/c/g?y#s"},
+        {"","http://a/b/c/d?q"},
+        {".","http://a/b/c/"},
+        {"./","http://a/b/c/"},
+        {"..","http://a/b/"},
+        {"../","http://a/b/"},
+        {"../g","http://a/b/g"},
+        {"../..","http://a/"},
+        {"../../","http://a/"},
+        {"../../g","http://a/g"},
+        {"../../../g","http://a/g"},
+        {"../../../../g","http://a/g"},
+        {"/./g","http://a/g"},
+        {"/../g","http://a/g"},
+        {"g.","http://a/b/c/g."},
+        {".g","http://a/b/c/.g"},
+        {"g..","http://a/b/c/g.."},
+        {"..g","http://a/b/c/..g"},
+        {"./../g","http://a/b/g"},
+        {"./g/.","http://a/b/c/g/"},
+        {"g/./h","http://a/b/c/g/h"},
+        {"g/../h","http://a/b/c/h"},
+        {"http:g","http:g"},
+        {"//cdn.host/x","http://cdn.host/x"},
+    };
+
+    unsigned int err = NO_UPARSE_ERROR;
+    url_t *base = parse_url("http://a/b/c/d?q",&err);
+    if (NULL == base) {
+        fprintf(stderr,"cannot parse base\n");
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    char buf[64];
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        size_t const len = url_resolve(base,cases[i][0],buf,sizeof(buf),&err);
+        printf("\"%s\" -> %s\n",cases[i][0],buf);
+        if ((NO_UPARSE_ERROR != err) || (len != strlen(cases[i][1])) || (0 != strcmp(cases[i][1],buf))) {
+            fprintf(stderr,"wrong resolution of \"%s\"\n",cases[i][0]);
+            result = EXIT_FAILURE;
+        }
+    }
+
+    char small[12];
+    if ((0 != url_resolve(base,"../g",small,sizeof(small),&err)) || (OVERFLOW_ERROR != err)) {
+        fprintf(stderr,"short buffer not reported\n");
+        result = EXIT_FAILURE;
+    }
+
+    // A caller built url may have a port no parser would accept.
+    base->port = UINT_MAX;
+    char const *const want = "http://a:4294967295/b/c/g";
+    if ((strlen(want) != url_resolve(base,"g",buf,sizeof(buf),&err)) || (0 != strcmp(want,buf))) {
+        fprintf(stderr,"wrong resolution against port %u\n",UINT_MAX);
+        result = EXIT_FAILURE;
+    }
+
+    free_url_t(base);
+    return result;
+}
+
+int test_ipv4(void) {
+
+    struct {
+        char const         *url;
+        uparse_host_kind_t kind;
+        uint32_t           addr;
+    } cases[] = {
+        {"http://10.0.0.1/a",UPARSE_HOST_IPV4,0x0A000001},
+        {"http://192.168.100.254:8080",UPARSE_HOST_IPV4,0xC0A864FE},
+        {"http://255.255.255.255",UPARSE_HOST_IPV4,0xFFFFFFFF},
+        {"http://0.0.0.0",UPARSE_HOST_IPV4,0},
+        {"http://256.0.0.1",UPARSE_HOST_NAME,0},
+        {"http://10.0.0",UPARSE_HOST_NAME,0},
+        {"http://10.0.0.1.2",UPARSE_HOST_NAME,0},
+        {"http://10..0.1",UPARSE_HOST_NAME,0},
+        {"http://010.0.0.1",UPARSE_HOST_NAME,0},
+        {"http://1000.0.0.1",UPARSE_HOST_NAME,0},
+        {"http://10.0.0.1a",UPARSE_HOST_NAME,0},
+        {"http://foo.com",UPARSE_HOST_NAME,0},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        url_t *url = parse_url(cases[i].url,&err);
+        if (NULL == url) {
+            fprintf(stderr,"cannot parse %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        printf("%s -> kind %d addr %08x\n",cases[i].url,(int) url->host_kind,url->ipv4);
+        if ((cases[i].kind != url->host_kind) || (cases[i].addr != url->ipv4)) {
+            fprintf(stderr,"wrong host kind for %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+    }
+
+    // Bytes over 0x7f, which a lenient policy lets into hosts.
+    uint32_t addr = 0;
+    if (uparse_parse_ipv4("\xC0\x80.0.0.1",8,&addr) || uparse_parse_ipv4("1.0.0.\xB9",7,&addr)) {
+        fprintf(stderr,"ipv4 literal with a high byte accepted\n");
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
+
+int test_ipv6(void) {
+
+    struct {
+        char const *url;
+        bool       ok;
+        char const *hex;
+        unsigned   port;
+    } cases[] = {
+        {"http://[::1]/a",true,"00000000000000000000000000000001",0},
+        {"http://[2001:db8::8a2e:370:7334]:8080/",true,"20010db80000000000008a2e03707334",8080},
+        {"http://[2001:DB8:0:0:1:0:0:1]",true,"20010db8000000000001000000000001",0},
+        {"http://[::]",true,"00000000000000000000000000000000",0},
+        {"http://[fe80::]/?a=b",true,"fe800000000000000000000000000000",0},
+        {"http://[::ffff:10.0.0.1]",true,"00000000000000000000ffff0a000001",0},
+        {"http://[1:2:3:4:5:6:7:8]",true,"00010002000300040005000600070008",0},
+        {"http://[1:2:3:4:5:6:7:8:9]",false,NULL,0},
+        {"http://[1::2::3]",false,NULL,0},
+        {"http://[12345::1]",false,NULL,0},
+        {"http://[1:2]",false,NULL,0},
+        {"http://[::1",false,NULL,0},
+        {"http://[::1]x",false,NULL,0},
+        {"http://[::g]",false,NULL,0},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        url_t *url = parse_url(cases[i].url,&err);
+        if (!cases[i].ok) {
+            if (NULL != url) {
+                fprintf(stderr,"%s should not parse\n",cases[i].url);
+                free_url_t(url);
+                result = EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (NULL == url) {
+            fprintf(stderr,"cannot parse %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        char hex[33];
+        for (size_t j = 0; j < 16; j++) {
+            snprintf(hex + (2 * j),3,"%02x",url->ipv6[j]);
+        }
+        printf("%s -> %s %s port %u\n",cases[i].url,url->host,hex,url->port);
+        if ((UPARSE_HOST_IPV6 != url->host_kind) || (0 != strcmp(cases[i].hex,hex)) ||
+            (cases[i].port != url->port)) {
+            fprintf(stderr,"wrong ipv6 host for %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+    }
+    return result;
+}
+
+int test_feed(void) {
+
+    char const *const urls[] = {
+        "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom",
+        "http://foo.com",
+        "http://[::1]:8080/a",
+        "http://10.0.0.1/a?",
+        "Gopherx://Foo.com/a",
+    };
+
+    int result = EXIT_SUCCESS;
+    char buf[128];
+    for (size_t i = 0; i < sizeof(urls)/sizeof(char *); i++) {
+        size_t const len = strlen(urls[i]);
+        unsigned int err = NO_UPARSE_ERROR;
+        url_t *whole = parse_url(urls[i],&err);
+        char expected[128];
+        url_format(whole,expected,sizeof(expected));
+
+        // Split the url at every point, and once into single chars.
+        for (size_t split = 0; split <= len; split++) {
+            uparse_feed_t f;
+            uparse_feed_init(&f);
+            size_t used = 0;
+            uparse_feed_status_t status = UPARSE_FEED_MORE;
+            if (0 == split) {
+                for (size_t j = 0; (j < len) && (UPARSE_FEED_MORE == status); j++) {
+                    status = uparse_feed(&f,urls[i] + j,1,&used);
+                }
+            } else {
+                status = uparse_feed(&f,urls[i],split,&used);
+                if (UPARSE_FEED_MORE == status) {
+                    status = uparse_feed(&f,urls[i] + split,len - split,&used);
+                }
+            }
+            if (UPARSE_FEED_MORE == status) {
+                status = uparse_feed_finish(&f);
+            }
+            url_t *fed = uparse_feed_url(&f,&err);
+            if ((UPARSE_FEED_DONE != status) || (NULL == fed)) {
+                fprintf(stderr,"cannot feed %s split at %lu\n",urls[i],split);
+                result = EXIT_FAILURE;
+                continue;
+            }
+            url_format(fed,buf,sizeof(buf));
+            if ((0 != strcmp(expected,buf)) || (whole->host_kind != fed->host_kind) ||
+                (whole->scheme_kind != fed->scheme_kind) || (0 != strcmp(whole->scheme,fed->scheme))) {
+                fprintf(stderr,"fed %s split at %lu as %s\n",urls[i],split,buf);
+                result = EXIT_FAILURE;
+            }
+            free_url_t(fed);
+        }
+        printf("fed %s in every split\n",expected);
+        free_url_t(whole);
+    }
+
+    // A request line: the url ends at the space, which is not consumed.
+    char const *const line = "/ignored http://foo.com/a?b=c HTTP/1.1";
+    uparse_feed_t f;
+    uparse_feed_init(&f);
+    size_t used = 0;
+    unsigned int err = NO_UPARSE_ERROR;
+    if ((UPARSE_FEED_MORE != uparse_feed(&f,line + 9,8,&used)) ||
+        (UPARSE_FEED_DONE != uparse_feed(&f,line + 17,strlen(line + 17),&used)) || (12 != used)) {
+        fprintf(stderr,"request line url did not end at the space\n");
+        result = EXIT_FAILURE;
+    }
+    url_t *url = uparse_feed_url(&f,&err);
+    if ((NULL == url) || (0 != strcmp("b=c",url->query))) {
+        fprintf(stderr,"wrong url from request line\n");
+        result = EXIT_FAILURE;
+    }
+    if (NULL != url) {
+        free_url_t(url);
+    }
+
+    // Bad input is rejected at the first bad char, before the url ends.
+    char const *const bad[] = {"ht1p://","http:x","http://foo}","http://foo.com:99999","http://foo.com/a?x!"};
+    for (size_t i = 0; i < sizeof(bad)/sizeof(char *); i++) {
+        uparse_feed_init(&f);
+        if (UPARSE_FEED_ERROR != uparse_feed(&f,bad[i],strlen(bad[i]),&used)) {
+            fprintf(stderr,"%s was not rejected\n",bad[i]);
+            result = EXIT_FAILURE;
+        }
+    }
+    char const *const unfinished[] = {"http","http://","http://foo.com:"};
+    for (size_t i = 0; i < sizeof(unfinished)/sizeof(char *); i++) {
+        uparse_feed_init(&f);
+        uparse_feed(&f,unfinished[i],strlen(unfinished[i]),&used);
+        if (UPARSE_FEED_ERROR != uparse_feed_finish(&f)) {
+            fprintf(stderr,"unfinished %s was not rejected\n",unfinished[i]);
+            result = EXIT_FAILURE;
+        }
+    }
+
+    // A bad query or fragment: parse_url keeps the rest of the url and
+    // reports the error, the feed rejects the whole url.
+    char const *const bad_tail[] = {"http://foo.com/a?b=!c","http://foo.com/a?b=c#d!"};
+    for (size_t i = 0; i < sizeof(bad_tail)/sizeof(char *); i++) {
+        url = parse_url(bad_tail[i],&err);
+        if ((NULL == url) || (UPARSE_ERROR != err) || (0 != strcmp("/a",url->path)) ||
+            (NULL != url->fragment) || ((0 == i) != (NULL == url->query))) {
+            fprintf(stderr,"parse_url did not keep the rest of %s\n",bad_tail[i]);
+            result = EXIT_FAILURE;
+        }
+        if (NULL != url) {
+            free_url_t(url);
+        }
+        uparse_feed_init(&f);
+        if ((UPARSE_FEED_ERROR != uparse_feed(&f,bad_tail[i],strlen(bad_tail[i]),&used)) ||
+            (NULL != (url = uparse_feed_url(&f,&err))) || (UPARSE_ERROR != err)) {
+            fprintf(stderr,"feed did not reject %s\n",bad_tail[i]);
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
+
+int test_request_target(void) {
+
+    struct {
+        char const           *target;
+        bool                 ok;
+        uparse_target_form_t form;
+        char const           *formatted;
+    } cases[] = {
+        {"/",true,UPARSE_TARGET_ORIGIN,"/"},
+        {"/where?q=now",true,UPARSE_TARGET_ORIGIN,"/where?q=now"},
+        {"/a/b/c",true,UPARSE_TARGET_ORIGIN,"/a/b/c"},
+        {"http://www.example.org/pub/WWW/TheProject",true,UPARSE_TARGET_ABSOLUTE,
+         "http://www.example.org/pub/WWW/TheProject"},
+        {"www.example.com:80",true,UPARSE_TARGET_AUTHORITY,"www.example.com:80"},
+        {"[::1]:443",true,UPARSE_TARGET_AUTHORITY,"[::1]:443"},
+        {"*",true,UPARSE_TARGET_ASTERISK,"*"},
+        {"www.example.com",false,UPARSE_TARGET_AUTHORITY,NULL},
+        {"www.example.com:80/x",false,UPARSE_TARGET_AUTHORITY,NULL},
+        {"/a|b",false,UPARSE_TARGET_ORIGIN,NULL},
+        {"http//x",false,UPARSE_TARGET_AUTHORITY,NULL},
+    };
+
+    int result = EXIT_SUCCESS;
+    char buf[128];
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        uparse_target_form_t form = UPARSE_TARGET_ORIGIN;
+        url_t *url = parse_request_target(cases[i].target,&form,&err);
+        if (!cases[i].ok) {
+            if (NULL != url) {
+                fprintf(stderr,"%s should not parse\n",cases[i].target);
+                free_url_t(url);
+                result = EXIT_FAILURE;
+            }
+            continue;
+        }
+        if (NULL == url) {
+            fprintf(stderr,"cannot parse target %s\n",cases[i].target);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        url_format(url,buf,sizeof(buf));
+        printf("%s -> form %d %s\n",cases[i].target,(int) form,buf);
+        print_url(url);
+        char escaped[128];
+        url_format_ex(url,escaped,sizeof(escaped),UPARSE_FORMAT_ESCAPE);
+        if ((cases[i].form != form) || (0 != strcmp(cases[i].formatted,buf)) ||
+            ((UPARSE_TARGET_ASTERISK == form) && (0 != strcmp("*",escaped)))) {
+            fprintf(stderr,"wrong request target %s\n",cases[i].target);
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+    }
+    return result;
+}
+
+int test_intern(void) {
+
+    uparse_intern_t *intern = uparse_intern_new(4);
+    if (NULL == intern) {
+        fprintf(stderr,"cannot make intern table\n");
+        return EXIT_FAILURE;
+    }
+
+    // Known schemes like http are never interned, unknown ones are.
+    int result = EXIT_SUCCESS;
+    unsigned int err = NO_UPARSE_ERROR;
+    url_t *a = parse_url_interned("myproto://foo.com/a?x=1",intern,&err);
+    url_t *b = parse_url_interned("myproto://foo.com:80/b",intern,&err);
+    url_t *c = parse_url_interned("http://bar.com/c",intern,&err);
+    url_t *f = parse_url_interned("myproto://Foo.COM/f",intern,&err);
+    if ((NULL == a) || (NULL == b) || (NULL == c) || (NULL == f)) {
+        fprintf(stderr,"bad retval from parse_url_interned\n");
+        result = EXIT_FAILURE;
+    } else {
+        printf("host ids %u %u %u, scheme ids %u %u %u, %lu interned\n",
+               a->host_id,b->host_id,c->host_id,
+               a->scheme_id,b->scheme_id,c->scheme_id,
+               uparse_intern_count(intern));
+        if ((a->host != b->host) || (a->host_id != b->host_id) ||
+            (a->host != f->host) || (a->host_id != f->host_id) ||
+            (a->host_id == c->host_id) || (a->scheme != b->scheme) ||
+            (NO_INTERN_ID == a->scheme_id) || (NO_INTERN_ID != c->scheme_id) ||
+            (0 != strcmp("bar.com",uparse_intern_lookup_id(intern,c->host_id))) ||
+            (3 != uparse_intern_count(intern))) {
+            fprintf(stderr,"interned hosts do not match\n");
+            result = EXIT_FAILURE;
+        }
+    }
+
+    // The table only holds four strings, after that urls get their own copy.
+    url_t *d = parse_url_interned("ftp://baz.com/d",intern,&err);
+    url_t *e = parse_url_interned("ftp://qux.com/e",intern,&err);
+    if ((NULL == d) || (NULL == e) || (NO_INTERN_ID == d->host_id) || (NO_INTERN_ID != e->host_id)) {
+        fprintf(stderr,"full intern table not handled\n");
+        result = EXIT_FAILURE;
+    }
+
+    url_t *urls[] = {a,b,c,d,e,f};
+    for (size_t i = 0; i < sizeof(urls)/sizeof(url_t *); i++) {
+        if (NULL != urls[i]) {
+            free_url_t(urls[i]);
+        }
+    }
+    uparse_intern_free(intern);
+    return result;
+}
+
+#define CACHE_THREADS 4
+#define CACHE_GETS    1000
+
+static void *cache_gets(void *arg) {
+    uparse_cache_t *cache = (uparse_cache_t *) arg;
+    char const *const u = "http://shared.com/a?x=1";
+    unsigned int err = NO_UPARSE_ERROR;
+    for (size_t i = 0; i < CACHE_GETS; i++) {
+        uparse_cached_release(uparse_cache_get(cache,u,strlen(u),&err));
+    }
+    return NULL;
+}
+
+int test_cache(void) {
+
+    // Room for a handful of entries in a single shard.
+    uparse_cache_t *cache = uparse_cache_new(1,1024);
+    if (NULL == cache) {
+        fprintf(stderr,"cannot make cache\n");
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    unsigned int err = NO_UPARSE_ERROR;
+    char const *const u = "http://foo.com/a?x=1&y=2";
+    uparse_cached_t const *a = uparse_cache_get(cache,u,strlen(u),&err);
+    uparse_cached_t const *b = uparse_cache_get(cache,u,strlen(u),&err);
+    if ((NULL == a) || (a != b) || (NULL == a->query_args) || (2 != a->query_args->count)) {
+        fprintf(stderr,"cached result does not match\n");
+        result = EXIT_FAILURE;
+    }
+
+    // Bad urls are not cached.
+    char const *const bad = "http//";
+    if (NULL != uparse_cache_get(cache,bad,strlen(bad),&err)) {
+        fprintf(stderr,"bad url was cached\n");
+        result = EXIT_FAILURE;
+    }
+
+    // Push a out of the cache while we still hold it.
+    char url_buf[64];
+    for (size_t i = 0; i < 32; i++) {
+        snprintf(url_buf,sizeof(url_buf),"http://foo%lu.com/b",i);
+        uparse_cached_release(uparse_cache_get(cache,url_buf,strlen(url_buf),&err));
+    }
+
+    uparse_cache_stats_t stats;
+    uparse_cache_stats(cache,&stats);
+    printf("cache hits %lu misses %lu evictions %lu entries %lu bytes %lu\n",
+           stats.hits,stats.misses,stats.evictions,stats.entries,stats.bytes);
+    if ((1 != stats.hits) || (34 != stats.misses) || (0 == stats.evictions) || (stats.bytes > 1024)) {
+        fprintf(stderr,"unexpected cache stats\n");
+        result = EXIT_FAILURE;
+    }
+    if ((NULL != a) && (0 != strcmp("foo.com",a->url->host))) {
+        fprintf(stderr,"evicted result was freed\n");
+        result = EXIT_FAILURE;
+    }
+
+    uparse_cached_release(a);
+    uparse_cached_release(b);
+    uparse_cache_free(cache);
+
+    // A budget too small to split between the shards would cache nothing.
+    cache = uparse_cache_new(16,1024);
+    if (NULL != cache) {
+        fprintf(stderr,"cache made with 64 bytes a shard\n");
+        uparse_cache_free(cache);
+        result = EXIT_FAILURE;
+    }
+
+    // Threads racing to fill the same url count one miss between them:
+    // a thread whose parse lost the race got the cached result, a hit.
+    cache = uparse_cache_new(1,1 << 20);
+    pthread_t threads[CACHE_THREADS];
+    for (size_t i = 0; i < CACHE_THREADS; i++) {
+        pthread_create(&threads[i],NULL,cache_gets,cache);
+    }
+    for (size_t i = 0; i < CACHE_THREADS; i++) {
+        pthread_join(threads[i],NULL);
+    }
+    uparse_cache_stats(cache,&stats);
+    if ((1 != stats.misses) || ((CACHE_THREADS * CACHE_GETS) - 1 != stats.hits)) {
+        fprintf(stderr,"racing cache gets counted %zu hits %zu misses\n",stats.hits,stats.misses);
+        result = EXIT_FAILURE;
+    }
+    uparse_cache_free(cache);
+    return result;
+}
+
+int test_policy(void) {
+
+    struct {
+        char const *url;
+        bool       ok[UPARSE_POLICY_COUNT];
+    } cases[] = {
+        // legacy, lenient, strict
+        {"http://foo.com/a/b?c=d#e",{true,true,true}},
+        {"http://my-host.example.com/",{false,true,true}},
+        {"http://foo.com/a-b_c.d~e",{false,true,true}},
+        {"http://foo.com/a?q=x+y&r=%20",{false,true,true}},
+        {"http://foo.com/a#top-1",{false,true,true}},
+        {"http://foo.com/a|b",{false,true,false}},
+        {"http://foo.com/a?q={x}",{false,true,false}},
+        {"http://caf\xc3\xa9.fr/",{false,true,false}},
+        {"http://foo.com/a b",{false,false,false}},
+        {"http://foo.com/a?b#c#d",{false,false,false}},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        for (unsigned int p = 0; p < UPARSE_POLICY_COUNT; p++) {
+            unsigned int err = NO_UPARSE_ERROR;
+            url_t *url = parse_url_ex(cases[i].url,NULL,(uparse_policy_t) p,&err);
+            // a bad fragment or query is left out of the url rather than failing it
+            bool const ok = (NULL != url) && (NO_UPARSE_ERROR == err);
+            if (ok != cases[i].ok[p]) {
+                fprintf(stderr,"%s under policy %u: parsed %d\n",cases[i].url,p,(int) ok);
+                result = EXIT_FAILURE;
+            }
+            if (NULL != url) {
+                free_url_t(url);
+            }
+        }
+    }
+
+    // No table lets a component swallow its own terminator or a space.
+    for (unsigned int p = 0; p < UPARSE_POLICY_COUNT; p++) {
+        uint8_t const *const classes = uparse_char_classes((uparse_policy_t) p);
+        if ((0 != classes[' ']) || (0 != classes['\n']) || (0 != classes['#']) ||
+            (0 != (classes['?'] & UPARSE_CLASS_PATH)) ||
+            (0 != (classes[':'] & UPARSE_CLASS_HOST)) || (0 != (classes['/'] & UPARSE_CLASS_HOST))) {
+            fprintf(stderr,"policy %u table has a delimiter\n",p);
+            result = EXIT_FAILURE;
+        }
+    }
+    if (NULL != uparse_char_classes(UPARSE_POLICY_COUNT)) {
+        fprintf(stderr,"unknown policy has a table\n");
+        result = EXIT_FAILURE;
+    }
+
+    // The push parser follows the policy it was started with.
+    char const *chunks[] = {"http://my-ho","st.com/a-b?x=1","+2 HTTP/1.1"};
+    uparse_feed_t f;
+    uparse_feed_init_ex(&f,UPARSE_POLICY_LENIENT);
+    uparse_feed_status_t status = UPARSE_FEED_MORE;
+    for (size_t i = 0; (i < 3) && (UPARSE_FEED_MORE == status); i++) {
+        size_t used = 0;
+        status = uparse_feed(&f,chunks[i],strlen(chunks[i]),&used);
+    }
+    unsigned int err = NO_UPARSE_ERROR;
+    url_t *url = uparse_feed_url(&f,&err);
+    char buf[128];
+    if ((UPARSE_FEED_DONE != status) || (NULL == url) ||
+        (url_format(url,buf,sizeof(buf)) >= sizeof(buf)) ||
+        (0 != strcmp("http://my-host.com/a-b?x=1+2",buf))) {
+        fprintf(stderr,"lenient feed failed\n");
+        result = EXIT_FAILURE;
+    }
+    if (NULL != url) {
+        free_url_t(url);
+    }
+
+    uparse_feed_init(&f);
+    size_t used = 0;
+    if (UPARSE_FEED_ERROR != uparse_feed(&f,chunks[0],strlen(chunks[0]),&used)) {
+        fprintf(stderr,"default feed accepted -\n");
+        result = EXIT_FAILURE;
+    }
+
+    // A path that parses under a policy also splits, routes and parses as a
+    // request target under it, and not under the default.
+    char const *const path = "/static/app.min.js";
+    uparse_span_t segs[4];
+    size_t overflow = 0;
+    if ((2 != get_path_segments_ex(path,segs,4,&overflow,UPARSE_POLICY_LENIENT,&err)) ||
+        (NO_UPARSE_ERROR != err) || (10 != segs[1].len) || (0 != memcmp("app.min.js",segs[1].ptr,10))) {
+        fprintf(stderr,"lenient path did not split\n");
+        result = EXIT_FAILURE;
+    }
+    if ((0 != get_path_segments(path,segs,4,&overflow,&err)) || (UPARSE_ERROR != err)) {
+        fprintf(stderr,"default policy split %s\n",path);
+        result = EXIT_FAILURE;
+    }
+    uparse_path_iter_t iter;
+    if (uparse_path_iter_init_ex(&iter,path,UPARSE_POLICY_COUNT) || uparse_path_iter_next(&iter,&segs[0],&err)) {
+        fprintf(stderr,"path iter took an unknown policy\n");
+        result = EXIT_FAILURE;
+    }
+
+    uparse_target_form_t form = UPARSE_TARGET_ORIGIN;
+    url = parse_request_target_ex("/a_b.js?q=x+y",UPARSE_POLICY_LENIENT,&form,&err);
+    if ((NULL == url) || (UPARSE_TARGET_ORIGIN != form) || (0 != strcmp("/a_b.js",url->path))) {
+        fprintf(stderr,"lenient request target failed\n");
+        result = EXIT_FAILURE;
+    }
+    if (NULL != url) {
+        free_url_t(url);
+    }
+    url = parse_request_target_ex("http://my-host.com/",UPARSE_POLICY_LENIENT,&form,&err);
+    if ((NULL == url) || (UPARSE_TARGET_ABSOLUTE != form)) {
+        fprintf(stderr,"lenient absolute request target failed\n");
+        result = EXIT_FAILURE;
+    }
+    if (NULL != url) {
+        free_url_t(url);
+    }
+    url = parse_request_target("/a_b.js",&form,&err);
+    if (NULL != url) {
+        fprintf(stderr,"default request target accepted _\n");
+        free_url_t(url);
+        result = EXIT_FAILURE;
+    }
+
+    uparse_router_t *router = uparse_router_new_ex(UPARSE_POLICY_LENIENT);
+    uparse_route_match_t match;
+    if (!uparse_router_add(router,"/static/app.min.js",1,&err) ||
+        !uparse_router_add(router,"/users/:id",2,&err) ||
+        uparse_router_add(router,"/a?b",3,&err) ||
+        !uparse_router_compile(router,&err) ||
+        !uparse_router_match(router,path,&match) || (1 != match.route_id) ||
+        !uparse_router_match(router,"/users/a-b_c",&match) || (2 != match.route_id)) {
+        fprintf(stderr,"lenient router failed\n");
+        result = EXIT_FAILURE;
+    }
+    uparse_router_free(router);
+    router = uparse_router_new();
+    if (uparse_router_add(router,path,1,&err)) {
+        fprintf(stderr,"default router accepted %s\n",path);
+        result = EXIT_FAILURE;
+    }
+    uparse_router_free(router);
+    return result;
+}
+
+static bool span_is(uparse_span_t span,char const *s) {
+    if (NULL == s) {
+        return NULL == span.ptr;
+    }
+    return (NULL != span.ptr) && (strlen(s) == span.len) && (0 == memcmp(span.ptr,s,span.len));
+}
+
+// Whether two spans hold the same bytes, or both have a NULL ptr.
+
+static bool spans_equal(uparse_span_t a,uparse_span_t b) {
+    if ((NULL == a.ptr) || (NULL == b.ptr)) {
+        return a.ptr == b.ptr;
+    }
+    return (a.len == b.len) && (0 == memcmp(a.ptr,b.ptr,a.len));
+}
+
+int test_compact(void) {
+
+    struct {
+        char const   *url;
+        char const   *scheme;
+        char const   *host;
+        unsigned int port;
+        char const   *path;
+        char const   *query;
+        char const   *fragment;
+    } cases[] = {
+        {"https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom","https","foo.bar.com",512,
+         "/foo/bar/baz","a=bbb&c=ddddd","boom"},
+        {"http://foo.com","http","foo.com",0,"/",NULL,NULL},
+        {"myproto://10.0.0.1/a?","myproto","10.0.0.1",0,"/a","",NULL},
+        {"ftp://[::1]:21/pub#","ftp","[::1]",21,"/pub",NULL,""},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        url_t *url = parse_url(cases[i].url,&err);
+        if (NULL == url) {
+            fprintf(stderr,"cannot parse %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        uparse_compact_t *c = uparse_compact_from_url(url,&err);
+        if ((NULL == c) || (NO_UPARSE_ERROR != err)) {
+            fprintf(stderr,"cannot compact %s\n",cases[i].url);
+            free_url_t(url);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        printf("%s compacts to %lu bytes\n",cases[i].url,uparse_compact_size(c));
+        if (!span_is(uparse_compact_scheme(c),cases[i].scheme) ||
+            !span_is(uparse_compact_host(c),cases[i].host) ||
+            (cases[i].port != uparse_compact_port(c)) ||
+            !span_is(uparse_compact_path(c),cases[i].path) ||
+            !span_is(uparse_compact_query(c),cases[i].query) ||
+            !span_is(uparse_compact_fragment(c),cases[i].fragment) ||
+            (url->scheme_kind != uparse_compact_scheme_kind(c)) ||
+            (url->host_kind != uparse_compact_host_kind(c)) ||
+            (url->ipv4 != uparse_compact_ipv4(c))) {
+            fprintf(stderr,"wrong compact url for %s\n",cases[i].url);
+            result = EXIT_FAILURE;
+        }
+        uparse_compact_free(c);
+        free_url_t(url);
+    }
+
+    // A typical url fits in a cache line.
+    unsigned int err = NO_UPARSE_ERROR;
+    uparse_compact_t *c = uparse_compact_parse("https://www.example.com/a/b/c?id=12345",&err);
+    if ((NULL == c) || (64 < uparse_compact_size(c))) {
+        fprintf(stderr,"compact url is too big\n");
+        result = EXIT_FAILURE;
+    }
+    uparse_compact_free(c);
+
+    if (NULL != uparse_compact_parse("http//foo.com",&err)) {
+        fprintf(stderr,"bad url compacted\n");
+        result = EXIT_FAILURE;
+    }
+
+    // uparse_compact_parse does not go through a url_t, but takes and
+    // rejects the same urls and gives the same compact url.
+    char const *const agree[] = {
+        "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom",
+        "HTTP://Foo.COM",
+        "myproto://10.0.0.1/a?",
+        "MyProto://10.0.0.1/a?",
+        "ftp://[::1]:21/pub#",
+        "https://foo.bar.com:512?u=1234",
+        "http://foo.com:43534534534",
+        "http://foo.com:444fff666",
+        "http:// foo bar/",
+        "http://foo.com}",
+        "sftp:/|",
+        "http://my.domain:",
+        "://my.domain",
+        "https://foo.bar.com:512/foo/bar/baz ?a=bbb",
+        "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#bo om",
+        " http://foo.com",
+    };
+    for (size_t i = 0; i < sizeof(agree)/sizeof(agree[0]); i++) {
+        url_t *url = parse_url(agree[i],&err);
+        uparse_compact_t *via_url = ((NULL == url) || (NO_UPARSE_ERROR != err)) ? NULL :
+                                    uparse_compact_from_url(url,&err);
+        uparse_compact_t *direct = uparse_compact_parse(agree[i],&err);
+        if ((NULL == via_url) != (NULL == direct)) {
+            fprintf(stderr,"compact parse and parse_url disagree on %s\n",agree[i]);
+            result = EXIT_FAILURE;
+        } else if ((NULL != direct) &&
+                   ((uparse_compact_size(via_url) != uparse_compact_size(direct)) ||
+                    (uparse_compact_port(via_url) != uparse_compact_port(direct)) ||
+                    (uparse_compact_scheme_kind(via_url) != uparse_compact_scheme_kind(direct)) ||
+                    (uparse_compact_host_kind(via_url) != uparse_compact_host_kind(direct)) ||
+                    (uparse_compact_ipv4(via_url) != uparse_compact_ipv4(direct)) ||
+                    !spans_equal(uparse_compact_scheme(via_url),uparse_compact_scheme(direct)) ||
+                    !spans_equal(uparse_compact_host(via_url),uparse_compact_host(direct)) ||
+                    !spans_equal(uparse_compact_path(via_url),uparse_compact_path(direct)) ||
+                    !spans_equal(uparse_compact_query(via_url),uparse_compact_query(direct)) ||
+                    !spans_equal(uparse_compact_fragment(via_url),uparse_compact_fragment(direct)))) {
+            fprintf(stderr,"compact parse of %s differs\n",agree[i]);
+            result = EXIT_FAILURE;
+        }
+        uparse_compact_free(via_url);
+        uparse_compact_free(direct);
+        if (NULL != url) {
+            free_url_t(url);
+        }
+    }
+    if ((NULL != uparse_compact_from_url(NULL,&err)) || (UPARSE_ERROR != err)) {
+        fprintf(stderr,"null url compacted\n");
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
+
+int test_psl(void) {
+
+    // A slice of the list used by the publicsuffix.org test cases.
+    char const *const list =
+        "// comment\n"
+        "com\n"
+        "\n"
+        "  uk   trailing text\n"
+        "co.uk\n"
+        "jp\n"
+        "ac.jp\n"
+        "kyoto.jp\n"
+        "ide.kyoto.jp\n"
+        "*.kobe.jp\n"
+        "!city.kobe.jp\n"
+        "*.ck\n"
+        "!www.ck\n"
+        "us\n"
+        "ak.us\n"
+        "k12.ak.us\n";
+
+    unsigned int err = NO_UPARSE_ERROR;
+    uparse_psl_t *psl = uparse_psl_load_buffer(list,strlen(list),&err);
+    if ((NULL == psl) || (NO_UPARSE_ERROR != err)) {
+        fprintf(stderr,"cannot load psl\n");
+        return EXIT_FAILURE;
+    }
+
+    struct {
+        char const *host;
+        char const *suffix;
+        char const *domain;
+    } cases[] = {
+        {"com","com",NULL},
+        {"example.com","com","example.com"},
+        {"WWW.Example.COM","COM","Example.COM"},
+        {"www.example.com.","com","example.com"},
+        {"example","example",NULL},
+        {"b.example.local","local","example.local"},
+        {"uk.com","com","uk.com"},
+        {"a.b.example.co.uk","co.uk","example.co.uk"},
+        {"test.ac.jp","ac.jp","test.ac.jp"},
+        {"www.test.ac.jp","ac.jp","test.ac.jp"},
+        {"b.ide.kyoto.jp","ide.kyoto.jp","b.ide.kyoto.jp"},
+        {"c.kobe.jp","c.kobe.jp",NULL},
+        {"b.c.kobe.jp","c.kobe.jp","b.c.kobe.jp"},
+        {"city.kobe.jp","kobe.jp","city.kobe.jp"},
+        {"www.city.kobe.jp","kobe.jp","city.kobe.jp"},
+        {"ck","ck",NULL},
+        {"test.ck","test.ck",NULL},
+        {"b.test.ck","test.ck","b.test.ck"},
+        {"www.ck","ck","www.ck"},
+        {"www.www.ck","ck","www.ck"},
+        {"www.k12.ak.us","k12.ak.us","www.k12.ak.us"},
+        {"192.168.0.1",NULL,NULL},
+        {"[::1]",NULL,NULL},
+        {"a..com",NULL,NULL},
+        {"",NULL,NULL},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        uparse_span_t host = {cases[i].host,strlen(cases[i].host)};
+        if (!span_is(uparse_psl_public_suffix(psl,host),cases[i].suffix) ||
+            !span_is(url_registrable_domain(psl,host),cases[i].domain)) {
+            fprintf(stderr,"wrong public suffix or registrable domain for %s\n",cases[i].host);
+            result = EXIT_FAILURE;
+        }
+    }
+    if (14 != uparse_psl_rule_count(psl)) {
+        fprintf(stderr,"wrong psl rule count %lu\n",uparse_psl_rule_count(psl));
+        result = EXIT_FAILURE;
+    }
+    uparse_psl_free(psl);
+
+    char const *const bad[] = {"a..b\n","*.\n","a.*.b\n","!*.b\n",".a\n"};
+    for (size_t i = 0; i < sizeof(bad)/sizeof(bad[0]); i++) {
+        psl = uparse_psl_load_buffer(bad[i],strlen(bad[i]),&err);
+        if (NULL != psl) {
+            fprintf(stderr,"bad psl rule %s loaded\n",bad[i]);
+            uparse_psl_free(psl);
+            result = EXIT_FAILURE;
+        }
+    }
+    if (NULL != uparse_psl_load("/no/such/psl.dat",&err)) {
+        fprintf(stderr,"missing psl file loaded\n");
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
+
+int test_match(void) {
+
+    struct {
+        char const   *rule;
+        unsigned int id;
+    } rules[] = {
+        {"example.com",1},
+        {"*.example.com",2},
+        {"example.com/ads/",3},
+        {"*.example.com/ads/",4},
+        {"*.example.com/ads/ok/",5},
+        {"Tracker.NET",6},
+        {"*.cdn.example.com",7},
+        {"example.com/ads/",9},
+        {"other.org/a",10},
+        {"other.org/ab",11},
+        {"other.org/a/b/c",12},
+    };
+
+    struct {
+        char const   *host;
+        char const   *path;
+        unsigned int id;
+    } cases[] = {
+        {"example.com","/",1},
+        {"EXAMPLE.com","/ads/x",3},
+        {"example.com.","/",1},
+        {"www.example.com","/",2},
+        {"www.example.com","/ads/1",4},
+        {"www.example.com","/ads/ok/1",5},
+        {"a.cdn.example.com","/",7},
+        {"a.cdn.example.com","/ads/x",7},
+        {"cdn.example.com","/ads/x",4},
+        {"tracker.net","/x",6},
+        {"www.tracker.net","/",NO_MATCH_ID},
+        {"example.org","/",NO_MATCH_ID},
+        {"com","/",NO_MATCH_ID},
+        {"other.org","/a",10},
+        {"other.org","/abc",11},
+        {"other.org","/a/b/cd",12},
+        {"other.org","/a/b",10},
+        {"other.org","/",NO_MATCH_ID},
+        {"other.org",NULL,NO_MATCH_ID},
+        {"x..example.com","/",NO_MATCH_ID},
+        {"","/",NO_MATCH_ID},
+    };
+
+    int result = EXIT_SUCCESS;
+
+    // The same answers with and without the bloom filter.
+    size_t const bloom_bits[] = {0,10};
+    for (size_t b = 0; b < 2; b++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        uparse_matcher_t *m = uparse_matcher_new();
+        for (size_t i = 0; i < sizeof(rules)/sizeof(rules[0]); i++) {
+            if (!uparse_matcher_add(m,rules[i].rule,rules[i].id,&err)) {
+                fprintf(stderr,"cannot add rule %s\n",rules[i].rule);
+                result = EXIT_FAILURE;
+            }
+        }
+        if (!uparse_matcher_compile(m,bloom_bits[b],&err)) {
+            fprintf(stderr,"cannot compile matcher\n");
+            uparse_matcher_free(m);
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+            uparse_span_t const host = {cases[i].host,strlen(cases[i].host)};
+            uparse_span_t path = {NULL,0};
+            if (NULL != cases[i].path) {
+                path.ptr = cases[i].path;
+                path.len = strlen(cases[i].path);
+            }
+            unsigned int const id = uparse_matcher_match(m,host,path);
+            if (cases[i].id != id) {
+                fprintf(stderr,"%s %s matched %u, not %u (bloom bits %lu)\n",
+                        cases[i].host,(NULL == cases[i].path) ? "-" : cases[i].path,id,cases[i].id,bloom_bits[b]);
+                result = EXIT_FAILURE;
+            }
+        }
+
+        url_t *url = parse_url("https://www.example.com/ads/ok/x",&err);
+        if ((NULL == url) || (5 != uparse_matcher_match_url(m,url))) {
+            fprintf(stderr,"parsed url did not match\n");
+            result = EXIT_FAILURE;
+        }
+        if (NULL != url) {
+            free_url_t(url);
+        }
+        if (uparse_matcher_add(m,"late.com",20,&err)) {
+            fprintf(stderr,"rule added to a compiled matcher\n");
+            result = EXIT_FAILURE;
+        }
+        uparse_matcher_free(m);
+    }
+
+    char const *const bad[] = {"","*.","a..b","exa mple.com","/path","a.*.com","x.com:80"};
+    uparse_matcher_t *m = uparse_matcher_new();
+    for (size_t i = 0; i < sizeof(bad)/sizeof(bad[0]); i++) {
+        unsigned int err = NO_UPARSE_ERROR;
+        if (uparse_matcher_add(m,bad[i],1,&err)) {
+            fprintf(stderr,"bad rule %s added\n",bad[i]);
+            result = EXIT_FAILURE;
+        }
+    }
+    uparse_matcher_free(m);
+    return result;
+}
+
+int test_extract(void) {
+
+    struct {
+        char const      *text;
+        uparse_policy_t policy;
+        char const      *urls[3];
+    } cases[] = {
+        {"see http://example.com/a/b.",UPARSE_POLICY_LENIENT,{"http://example.com/a/b",NULL,NULL}},
+        {"<a href=\"https://x.org/p?q=1#top\">x</a>",UPARSE_POLICY_LENIENT,{"https://x.org/p?q=1#top",NULL,NULL}},
+        {"(see http://example.com/a) and http://en.wikipedia.org/wiki/C_(language), ok",UPARSE_POLICY_LENIENT,
+         {"http://example.com/a","http://en.wikipedia.org/wiki/C_(language)",NULL}},
+        {"http://a.com:8080/x http://b.com: http://c.com:99999/",UPARSE_POLICY_LENIENT,
+         {"http://a.com:8080/x","http://b.com","http://c.com"}},
+        {"ftp://[::1]:21/pub, then ftp://[zz]/ and ://x.com and 1://y.com",UPARSE_POLICY_LENIENT,
+         {"ftp://[::1]:21/pub",NULL,NULL}},
+        {"xxxxxxxxxxxxxxxxhttp://a.com http:// http://.",UPARSE_POLICY_LENIENT,{NULL,NULL,NULL}},
+        {"http://a.com",UPARSE_POLICY_LENIENT,{"http://a.com",NULL,NULL}},
+        {"svn://bucket/key? s3://bucket/key",UPARSE_POLICY_LENIENT,{"svn://bucket/key",NULL,NULL}},
+        {"go to HTTP://Foo.com/a.html?x=1.",UPARSE_POLICY_LEGACY,{"HTTP://Foo.com/a",NULL,NULL}},
+        {"go to HTTP://Foo.com/a.html?x=1.",UPARSE_POLICY_LENIENT,{"HTTP://Foo.com/a.html?x=1",NULL,NULL}},
+        {"",UPARSE_POLICY_LENIENT,{NULL,NULL,NULL}},
+        {"http://[ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255]/a",UPARSE_POLICY_LENIENT,
+         {"http://[ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255]/a",NULL,NULL}},
+        // a ']' further than any ipv6 literal reaches is not looked for
+        {"http://[::1 a:b:c:d:e:f:0:1:2:3:4:5:6:7:8:9:a:b:c:d]/ http://x.com",UPARSE_POLICY_LENIENT,
+         {"http://x.com",NULL,NULL}},
+    };
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++) {
+        uparse_extract_t x;
+        if (!uparse_extract_init(&x,cases[i].text,strlen(cases[i].text),cases[i].policy)) {
+            fprintf(stderr,"cannot init extraction of %s\n",cases[i].text);
+            result = EXIT_FAILURE;
+            continue;
+        }
+        uparse_found_t found;
+        size_t n = 0;
+        while (uparse_extract_next(&x,&found)) {
+            if ((3 <= n) || (NULL == cases[i].urls[n]) || !span_is(found.url,cases[i].urls[n])) {
+                fprintf(stderr,"unexpected url %.*s in %s\n",(int) found.url.len,found.url.ptr,cases[i].text);
+                result = EXIT_FAILURE;
+                break;
+            }
+            n++;
+        }
+        if ((n < 3) && (NULL != cases[i].urls[n]) && (EXIT_SUCCESS == result)) {
+            fprintf(stderr,"url %s not found in %s\n",cases[i].urls[n],cases[i].text);
+            result = EXIT_FAILURE;
+        }
+    }
+
+    // The components of a found url, all pointing into the text.
+    char const *const text = "visit https://www.example.com:8443/a/b?c=d&e=f#g!";
+    uparse_extract_t x;
+    uparse_found_t found;
+    uparse_extract_init(&x,text,strlen(text),UPARSE_POLICY_LENIENT);
+    if (!uparse_extract_next(&x,&found) ||
+        (found.url.ptr != text + 6) ||
+        !span_is(found.url,"https://www.example.com:8443/a/b?c=d&e=f#g") ||
+        !span_is(found.scheme,"https") || (UPARSE_SCHEME_HTTPS != found.scheme_kind) ||
+        !span_is(found.host,"www.example.com") ||
+        !span_is(found.port,"8443") || (8443 != found.port_value) ||
+        !span_is(found.path,"/a/b") ||
+        !span_is(found.query,"c=d&e=f") ||
+        !span_is(found.fragment,"g") ||
+        uparse_extract_next(&x,&found)) {
+        fprintf(stderr,"wrong components extracted from %s\n",text);
+        result = EXIT_FAILURE;
+    }
+
+    // A url without a path, query or fragment.
+    char const *const bare = "mail me at http://a.b.c.";
+    uparse_extract_init(&x,bare,strlen(bare),UPARSE_POLICY_LEGACY);
+    if (!uparse_extract_next(&x,&found) ||
+        !span_is(found.host,"a.b.c") || (0 != found.port.len) || (0 != found.port_value) ||
+        (0 != found.path.len) || !span_is(found.query,NULL) || !span_is(found.fragment,NULL)) {
+        fprintf(stderr,"wrong components extracted from %s\n",bare);
+        result = EXIT_FAILURE;
+    }
+
+    // Only the given length is read, whatever follows it.
+    char const *const cut = "http://a.com/xyz";
+    uparse_extract_init(&x,cut,14,UPARSE_POLICY_LENIENT);
+    if (!uparse_extract_next(&x,&found) || !span_is(found.url,"http://a.com/x")) {
+        fprintf(stderr,"extraction read past the end of %s\n",cut);
+        result = EXIT_FAILURE;
+    }
+
+    if (uparse_extract_init(&x,text,strlen(text),UPARSE_POLICY_COUNT)) {
+        fprintf(stderr,"extraction with an unknown policy\n");
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
+
+int test_dict(void) {
+
+    char const *const added[] = {
+        "https://www.example.com/",
+        "https://www.example.com/a/b?x=1#top",
+        "https://www.example.com/a/b?x=1",
+        "https://www.example.com/a/b?",
+        "https://www.example.com/a/b#",
+        "http://www.example.com:8080/a/b",
+        "myproto://www.example.com/a",
+        "https://www.example.com/a/b?x=1",
+        "ftp://[::1]:21/pub",
+        "http://a.org",
+    };
+    char const *const absent[] = {
+        "https://www.example.com/a",
+        "https://www.example.com/a/b",
+        "https://www.example.com/a/b?x=1#to",
+        "http://www.example.com/a/b",
+        "https://example.com/",
+        "http://z.org/",
+        "http://0.org/",
+    };
+
+    int result = EXIT_SUCCESS;
+    unsigned int err = NO_UPARSE_ERROR;
+    uparse_dict_builder_t *b = uparse_dict_builder_new();
+    for (size_t i = 0; i < sizeof(added)/sizeof(added[0]); i++) {
+        url_t *url = parse_url(added[i],&err);
+        if ((NULL == url) || !uparse_dict_builder_add(b,url,&err)) {
+            fprintf(stderr,"cannot add %s to dict\n",added[i]);
+            result = EXIT_FAILURE;
+        }
+        if (NULL != url) {
+            free_url_t(url);
+        }
+    }
+    // Enough urls on one host to fill several blocks.
+    char buf[128];
+    for (size_t i = 0; i < 100; i++) {
+        snprintf(buf,sizeof(buf),"https://b.net/articles/%zu/comments?page=%zu",i,i % 3);
+        url_t *url = parse_url(buf,&err);
+        if ((NULL == url) || !uparse_dict_builder_add(b,url,&err)) {
+            fprintf(stderr,"cannot add %s to dict\n",buf);
+            result = EXIT_FAILURE;
+        }
+        if (NULL != url) {
+            free_url_t(url);
+        }
+    }
+
+    // Hosts are lowercased, so a url_t built by hand with a mixed case host
+    // is the same url as "http://a.org" and not added again.
+    url_t *mixed = parse_url("http://a.org",&err);
+    if (NULL != mixed) {
+        free(mixed->host);
+        mixed->host = strdup("A.Org");
+        if ((NULL == mixed->host) || !uparse_dict_builder_add(b,mixed,&err)) {
+            fprintf(stderr,"cannot add A.Org to dict\n");
+            result = EXIT_FAILURE;
+        }
+        free_url_t(mixed);
+    }
+
+    // A url_t built by hand may hold a delimiter in a part where the tail
+    // would be split at it, so it is refused.
+    struct {
+        char const *scheme;
+        char const *path;
+        char const *query;
+    } split_wrong[] = {
+        {"h:ttp","/",NULL},
+        {"http","/a?b",NULL},
+        {"http","/a#b",NULL},
+        {"http","/a","x#y"},
+    };
+    for (size_t i = 0; i < sizeof(split_wrong)/sizeof(split_wrong[0]); i++) {
+        url_t u;
+        init_url_t(&u);
+        u.scheme = split_wrong[i].scheme;
+        u.host = "c.org";
+        u.path = (char *) split_wrong[i].path;
+        u.query = (char *) split_wrong[i].query;
+        if (uparse_dict_builder_add(b,&u,&err) || (UPARSE_ERROR != err)) {
+            fprintf(stderr,"%s %s %s added to dict\n",u.scheme,u.path,(NULL == u.query) ? "" : u.query);
+            result = EXIT_FAILURE;
+        }
+    }
+
+    size_t len = 0;
+    char *image = uparse_dict_builder_build(b,&len,&err);
+    uparse_dict_t *d = (NULL == image) ? NULL : uparse_dict_open_buffer(image,len,&err);
+    if (NULL == d) {
+        fprintf(stderr,"cannot build dict\n");
+        uparse_dict_builder_free(b);
+        free(image);
+        return EXIT_FAILURE;
+    }
+    printf("dict of %zu urls on %zu hosts is %zu bytes\n",
+           uparse_dict_url_count(d),uparse_dict_host_count(d),uparse_dict_bytes(d));
+    if ((109 != uparse_dict_url_count(d)) || (4 != uparse_dict_host_count(d))) {
+        fprintf(stderr,"wrong dict counts\n");
+        result = EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sizeof(added)/sizeof(added[0]); i++) {
+        url_t *url = parse_url(added[i],&err);
+        if (!uparse_dict_contains(d,url)) {
+            fprintf(stderr,"dict lacks %s\n",added[i]);
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+    }
+    for (size_t i = 0; i < 100; i++) {
+        snprintf(buf,sizeof(buf),"https://b.net/articles/%zu/comments?page=%zu",i,(i + 1) % 3);
+        url_t *url = parse_url(buf,&err);
+        if (uparse_dict_contains(d,url)) {
+            fprintf(stderr,"dict has %s\n",buf);
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+    }
+    for (size_t i = 0; i < sizeof(absent)/sizeof(absent[0]); i++) {
+        url_t *url = parse_url(absent[i],&err);
+        if (uparse_dict_contains(d,url)) {
+            fprintf(stderr,"dict has %s\n",absent[i]);
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+    }
+    mixed = parse_url("https://www.example.com/a/b?x=1",&err);
+    if (NULL != mixed) {
+        free(mixed->host);
+        mixed->host = strdup("WWW.Example.COM");
+        if ((NULL == mixed->host) || !uparse_dict_contains(d,mixed)) {
+            fprintf(stderr,"dict lacks WWW.Example.COM\n");
+            result = EXIT_FAILURE;
+        }
+        free_url_t(mixed);
+    }
+
+    // The urls of one host come back sorted, in parts.
+    struct {
+        char const   *scheme;
+        unsigned int port;
+        char const   *path;
+        char const   *query;
+        char const   *fragment;
+    } www[] = {
+        {"http",8080,"/a/b",NULL,NULL},
+        {"https",0,"/",NULL,NULL},
+        {"https",0,"/a/b",NULL,""},
+        {"https",0,"/a/b","",NULL},
+        {"https",0,"/a/b","x=1",NULL},
+        {"https",0,"/a/b","x=1","top"},
+        {"myproto",0,"/a",NULL,NULL},
+    };
+    uparse_dict_iter_t *it = (uparse_dict_iter_t *) malloc(sizeof(uparse_dict_iter_t));
+    uparse_dict_url_t u;
+    size_t n = 0;
+    if (!uparse_dict_iter_init(it,d,(uparse_span_t) {"www.Example.com",15})) {
+        fprintf(stderr,"dict iter lacks www.example.com\n");
+        result = EXIT_FAILURE;
+    }
+    while (uparse_dict_iter_next(it,&u)) {
+        if ((sizeof(www)/sizeof(www[0]) <= n) ||
+            !span_is(u.host,"www.example.com") || !span_is(u.scheme,www[n].scheme) ||
+            (www[n].port != u.port) || !span_is(u.path,www[n].path) ||
+            !span_is(u.query,www[n].query) || !span_is(u.fragment,www[n].fragment)) {
+            fprintf(stderr,"wrong dict url %zu for www.example.com\n",n);
+            result = EXIT_FAILURE;
+            break;
+        }
+        n++;
+    }
+    if (sizeof(www)/sizeof(www[0]) != n) {
+        fprintf(stderr,"dict iter found %zu urls for www.example.com\n",n);
+        result = EXIT_FAILURE;
+    }
+    if (uparse_dict_iter_init(it,d,(uparse_span_t) {"example.com",11}) || uparse_dict_iter_next(it,&u)) {
+        fprintf(stderr,"dict iter has example.com\n");
+        result = EXIT_FAILURE;
+    }
+
+    // Every url, each once.
+    n = 0;
+    uparse_dict_iter_init(it,d,(uparse_span_t) {NULL,0});
+    while (uparse_dict_iter_next(it,&u)) {
+        n++;
+    }
+    if (uparse_dict_url_count(d) != n) {
+        fprintf(stderr,"dict iter found %zu urls, not %zu\n",n,uparse_dict_url_count(d));
+        result = EXIT_FAILURE;
+    }
+    uparse_dict_close(d);
+
+    // The same dictionary mapped from a file.
+    char const *const path = "uparse_dict_test.dat";
+    if (!uparse_dict_builder_write(b,path,&err) || (NULL == (d = uparse_dict_open(path,&err)))) {
+        fprintf(stderr,"cannot write and map dict\n");
+        result = EXIT_FAILURE;
+    } else {
+        url_t *url = parse_url("https://b.net/articles/42/comments?page=0",&err);
+        if ((len != uparse_dict_bytes(d)) || !uparse_dict_contains(d,url)) {
+            fprintf(stderr,"mapped dict differs\n");
+            result = EXIT_FAILURE;
+        }
+        free_url_t(url);
+        uparse_dict_close(d);
+    }
+    remove(path);
+    uparse_dict_builder_free(b);
+
+    // A truncated image is refused, and damaged blocks end lookups without
+    // reading outside the image.
+    if (NULL != uparse_dict_open_buffer(image,len - 1,&err)) {
+        fprintf(stderr,"truncated dict opened\n");
+        result = EXIT_FAILURE;
+    }
+    memset(image + len - 200,0xff,200);
+    d = uparse_dict_open_buffer(image,len,&err);
+    if (NULL != d) {
+        url_t *url = parse_url("https://b.net/articles/99/comments?page=0",&err);
+        uparse_dict_contains(d,url);
+        free_url_t(url);
+        uparse_dict_iter_init(it,d,(uparse_span_t) {NULL,0});
+        while (uparse_dict_iter_next(it,&u)) {
+        }
+        uparse_dict_close(d);
+    }
+    free(it);
+    free(image);
+    return result;
+}
+
 int main(void) {
 
+    int failures = 0;
+
     char *url_str[] =
         {
             "https://foo.bar.com:512/foo/bar/baz?a=bbb&c=ddddd#boom",
@@ -64,6 +1651,14 @@ int main(void) {
     free(esc_result1);
     free(esc_result2);
 
+    // url_escape and url_format share one escape table.
+    char *esc_result3 = url_escape("[::1]/a b");
+    if ((NULL == esc_result3) || (0 != strcmp("%5B%3A%3A1%5D%2Fa b",esc_result3))) {
+        fprintf(stderr,"url_escape gave %s\n",(NULL == esc_result3) ? "NULL" : esc_result3);
+        failures++;
+    }
+    free(esc_result3);
+
     char *arg_str[] = {
         "a=b&c=d", //ok
         "aaa=bbb&ccc=ddd", //ok
@@ -95,4 +1690,78 @@ int main(void) {
         }
         free_arg_list_t(r);
     }
+
+    printf("---------------------------------------\n");
+    if (EXIT_SUCCESS != test_scheme()) {
+        fprintf(stderr,"failure on scheme\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_path_segments()) {
+        fprintf(stderr,"failure on path segments\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_router()) {
+        fprintf(stderr,"failure on router\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_format()) {
+        fprintf(stderr,"failure on format\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_resolve()) {
+        fprintf(stderr,"failure on resolve\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_ipv4()) {
+        fprintf(stderr,"failure on ipv4\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_ipv6()) {
+        fprintf(stderr,"failure on ipv6\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_feed()) {
+        fprintf(stderr,"failure on feed\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_request_target()) {
+        fprintf(stderr,"failure on request target\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_intern()) {
+        fprintf(stderr,"failure on intern\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_cache()) {
+        fprintf(stderr,"failure on cache\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_policy()) {
+        fprintf(stderr,"failure on policy\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_compact()) {
+        fprintf(stderr,"failure on compact\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_psl()) {
+        fprintf(stderr,"failure on psl\n");
+        failures++;
+    }
+    if (EXIT_SUCCESS != test_match()) {
+        fprintf(stderr,"failure on match\n");
+        failures++;
+    }
+
+    if (EXIT_SUCCESS != test_extract()) {
+        fprintf(stderr,"failure on extract\n");
+        failures++;
+    }
+
+    if (EXIT_SUCCESS != test_dict()) {
+        fprintf(stderr,"failure on dict\n");
+        failures++;
+    }
+
+    return (0 == failures) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
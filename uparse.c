@@ -1,4 +1,8 @@
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "uparse.h"
+#include "uparse_internal.h"
 
 static int const NO_PORT                  = 0;
 static int const ERROR_PORT               = -1;
@@ -11,16 +15,116 @@ static char const DOMAIN_DELIM            = '.';
 static char const QUERY_DELIM             = '?';
 static char const QUERY_KEY_VAL_DELIM     = '='; 
 static char const FRAGMENT_DELIM          = '#';
+static char const IPV6_OPEN               = '[';
+static char const IPV6_CLOSE              = ']';
 static char const QUERY_PAIR_DELIM        = '&'; 
+static char const ASTERISK_TARGET         = '*';
 
-#define ESCAPE_CHARS_COUNT 19
+// -----------------------------------------
+// CHARACTER CLASSES
+// Each policy is one 256 entry table, indexed by unsigned char, with a bit
+// for each component the char may appear in. The compiler builds the tables
+// from the rules below, so checking a char costs a load and a mask whatever
+// the policy. No table has the delimiter that ends a component in that
+// component's bit, nor space or control chars.
+
+#define CC_ALNUM(c)      ((('a' <= (c)) && ((c) <= 'z')) || (('A' <= (c)) && ((c) <= 'Z')) || \
+                          (('0' <= (c)) && ((c) <= '9')))
+#define CC_UNRESERVED(c) (CC_ALNUM(c) || ('-' == (c)) || ('.' == (c)) || ('_' == (c)) || ('~' == (c)))
+#define CC_SUB_DELIM(c)  (('!' == (c)) || ('$' == (c)) || ('&' == (c)) || ('\'' == (c)) || \
+                          ('(' == (c)) || (')' == (c)) || ('*' == (c)) || ('+' == (c)) || \
+                          (',' == (c)) || (';' == (c)) || ('=' == (c)))
+#define CC_PCHAR(c)      (CC_UNRESERVED(c) || CC_SUB_DELIM(c) || (':' == (c)) || ('@' == (c)) || ('%' == (c)))
+
+// Chars browsers send unescaped though RFC 3986 does not allow them, and
+// the bytes of utf-8 sequences.
+#define CC_WEB(c)        (('"' == (c)) || ('<' == (c)) || ('>' == (c)) || ('[' == (c)) || \
+                          ('\\' == (c)) || (']' == (c)) || ('^' == (c)) || ('`' == (c)) || \
+                          ('{' == (c)) || ('|' == (c)) || ('}' == (c)) || (0x80 <= (c)))
+
+#define CC_LEGACY(c) \
+    (((CC_ALNUM(c) || ('.' == (c))) ? UPARSE_CLASS_HOST : 0) | \
+     ((CC_ALNUM(c) || ('/' == (c))) ? UPARSE_CLASS_PATH : 0) | \
+     ((CC_ALNUM(c) || ('&' == (c)) || ('=' == (c))) ? UPARSE_CLASS_QUERY : 0) | \
+     (CC_ALNUM(c) ? UPARSE_CLASS_FRAGMENT : 0))
+
+#define CC_LENIENT(c) \
+    (((CC_UNRESERVED(c) || (0x80 <= (c))) ? UPARSE_CLASS_HOST : 0) | \
+     ((CC_PCHAR(c) || CC_WEB(c) || ('/' == (c))) ? UPARSE_CLASS_PATH : 0) | \
+     ((CC_PCHAR(c) || CC_WEB(c) || ('/' == (c)) || ('?' == (c))) ? \
+      (UPARSE_CLASS_QUERY | UPARSE_CLASS_FRAGMENT) : 0))
+
+#define CC_STRICT(c) \
+    (((CC_UNRESERVED(c) || CC_SUB_DELIM(c) || ('%' == (c))) ? UPARSE_CLASS_HOST : 0) | \
+     ((CC_PCHAR(c) || ('/' == (c))) ? UPARSE_CLASS_PATH : 0) | \
+     ((CC_PCHAR(c) || ('/' == (c)) || ('?' == (c))) ? (UPARSE_CLASS_QUERY | UPARSE_CLASS_FRAGMENT) : 0))
+
+// The chars url_escape and url_format replace with a %XX escape.
+#define CC_ESCAPE(c) \
+    (('!' == (c)) || ('#' == (c)) || ('$' == (c)) || ('%' == (c)) || ('&' == (c)) || \
+     ('\'' == (c)) || ('(' == (c)) || (')' == (c)) || ('*' == (c)) || ('+' == (c)) || \
+     (',' == (c)) || ('/' == (c)) || (':' == (c)) || (';' == (c)) || ('=' == (c)) || \
+     ('?' == (c)) || ('@' == (c)) || ('[' == (c)) || (']' == (c)))
+
+#define CC_ROW(f,b) \
+    f((b) + 0x0),f((b) + 0x1),f((b) + 0x2),f((b) + 0x3),f((b) + 0x4),f((b) + 0x5),f((b) + 0x6),f((b) + 0x7), \
+    f((b) + 0x8),f((b) + 0x9),f((b) + 0xa),f((b) + 0xb),f((b) + 0xc),f((b) + 0xd),f((b) + 0xe),f((b) + 0xf)
+#define CC_TABLE(f) \
+    { CC_ROW(f,0x00),CC_ROW(f,0x10),CC_ROW(f,0x20),CC_ROW(f,0x30), \
+      CC_ROW(f,0x40),CC_ROW(f,0x50),CC_ROW(f,0x60),CC_ROW(f,0x70), \
+      CC_ROW(f,0x80),CC_ROW(f,0x90),CC_ROW(f,0xa0),CC_ROW(f,0xb0), \
+      CC_ROW(f,0xc0),CC_ROW(f,0xd0),CC_ROW(f,0xe0),CC_ROW(f,0xf0) }
+
+// In uparse_policy_t order.
+static uint8_t const CHAR_CLASSES[UPARSE_POLICY_COUNT][256] = {
+    CC_TABLE(CC_LEGACY),
+    CC_TABLE(CC_LENIENT),
+    CC_TABLE(CC_STRICT)
+};
+
+static bool const ESCAPE_CHARS[256] = CC_TABLE(CC_ESCAPE);
+
+#undef CC_TABLE
+#undef CC_ROW
+#undef CC_ESCAPE
+#undef CC_STRICT
+#undef CC_LENIENT
+#undef CC_LEGACY
+#undef CC_WEB
+#undef CC_PCHAR
+#undef CC_SUB_DELIM
+#undef CC_UNRESERVED
+#undef CC_ALNUM
+
+UPARSE_DEF uint8_t const *uparse_char_classes(uparse_policy_t policy) {
+    if (UPARSE_POLICY_COUNT <= (unsigned int) policy) {
+        return NULL;
+    }
+    return CHAR_CLASSES[policy];
+}
+
+// True if url_escape and url_format replace c.
+
+static bool needs_escape(char c) {
+    return ESCAPE_CHARS[(unsigned char) c];
+}
+
+// Write c as a %XX escape at d, returning the end of it.
 
-static char const ESCAPE_CHARS[ESCAPE_CHARS_COUNT] =
-    {'!','#','$','%','&','\'','(',')','*','+',
-     ',','/',':',';','=','?','@',']','['};
-static char const *const PERCENT_REPLACE[ESCAPE_CHARS_COUNT] =
-    {"%21","%23","%24","%25","%26","%27","%28","%29","%2A","%2B",
-     "%2C","%2F","%3A","%3B","%3D","%3F","%40","%5B","%5D"};
+static char *escape_char(char *d,char c) {
+    static char const hex[] = "0123456789ABCDEF";
+    unsigned char const u = (unsigned char) c;
+    *d++ = '%';
+    *d++ = hex[u >> 4];
+    *d++ = hex[u & 0xF];
+    return d;
+}
+
+// Whether c may appear in the component with class bit cls.
+
+static bool char_in_class(uint8_t const *classes,char c,uint8_t cls) {
+    return 0 != (classes[(unsigned char) c] & cls);
+}
 
 
 // -----------------------------------------
@@ -28,7 +132,7 @@ static char const *const PERCENT_REPLACE[ESCAPE_CHARS_COUNT] =
 // Url escape a string. Assumes all chars will need to be replaced,
 // allocates enough space to do so.
 
-char *url_escape(char const *const s) {
+UPARSE_DEF char *url_escape(char const *const s) {
 
     // Build an array large enough to support every char being escaped (replaced by three chars).
     size_t const c_esc_len = (3 * strlen(s)) + 1;
@@ -40,30 +144,18 @@ char *url_escape(char const *const s) {
 
     char const *c = s;
 
-    size_t j = 0;
-    bool percent_replaced = false;
+    char *d = esc_s;
 
     while (*c) {
-        percent_replaced = false;
-        for (size_t i = 0; i < ESCAPE_CHARS_COUNT; i++) {
-            if (ESCAPE_CHARS[i] == *c) {
-                // *c needs to be replaced in esc_s with PERCENT_REPLACE[i].
-                char const *t = PERCENT_REPLACE[i];
-                for (size_t k = 0; k < 3; k++) {
-                    esc_s[j++] = *t++;
-                }
-                percent_replaced = true;
-                break;
-            }
-        }
-        if (!percent_replaced) {
-            // *c was not a escape char.
-            esc_s[j++] = *c;
+        if (needs_escape(*c)) {
+            d = escape_char(d,*c);
+        } else {
+            *d++ = *c;
         }
         c++;
     }
 
-    esc_s[j] = '\0';
+    *d = '\0';
     return esc_s;
 }
 
@@ -71,19 +163,30 @@ char *url_escape(char const *const s) {
 // -----------------------------------------
 // A url is a { scheme, host_port, path, query, fragment }
 
-void init_url_t(url_t *url) {
+UPARSE_DEF void init_url_t(url_t *url) {
     url->scheme         = NULL;
     url->host           = NULL;
     url->port           = 0;
     url->path           = NULL;
     url->query          = NULL;
     url->fragment       = NULL;
+    url->scheme_id      = NO_INTERN_ID;
+    url->host_id        = NO_INTERN_ID;
+    url->scheme_kind    = UPARSE_SCHEME_UNKNOWN;
+    url->default_port   = 0;
+    url->host_kind      = UPARSE_HOST_NAME;
+    url->ipv4           = 0;
+    memset(url->ipv6,0,sizeof(url->ipv6));
 }
 
-void free_url_t(url_t *url) {
-    free(url->scheme);
+UPARSE_DEF void free_url_t(url_t *url) {
+    if ((UPARSE_SCHEME_UNKNOWN == url->scheme_kind) && (NO_INTERN_ID == url->scheme_id)) {
+        free((void *) url->scheme);
+    }
     url->scheme = NULL;
-    free(url->host);
+    if (NO_INTERN_ID == url->host_id) {
+        free(url->host);
+    }
     url->host = NULL;
     free(url->path);
     url->path = NULL;
@@ -95,13 +198,293 @@ void free_url_t(url_t *url) {
 }
 
 
+// -----------------------------------------
+// INTERN TABLES
+
+// An intern table is an open addressing hash table of immutable entries
+// with a fixed number of slots, so it never has to be rehashed. Readers
+// probe the slots with acquire loads and never lock. Writers serialize on
+// a mutex, fill in an entry completely and then publish it with a release
+// store, so a reader either sees the whole entry or an empty slot.
+
+typedef struct intern_entry_t {
+    uint64_t     hash;
+    size_t       len;
+    unsigned int id;
+    char         str[];
+} intern_entry_t;
+
+struct uparse_intern_t {
+    _Atomic(intern_entry_t *) *slots;
+    _Atomic(intern_entry_t *) *by_id;
+    size_t                    mask;
+    size_t                    capacity;
+    atomic_size_t             count;
+    pthread_mutex_t           lock;
+};
+
+// Make a table that will hold up to capacity distinct strings.
+UPARSE_DEF uparse_intern_t *uparse_intern_new(size_t capacity) {
+
+    if (0 == capacity) {
+        fprintf(stderr,"intern capacity must be nonzero\n");
+        return NULL;
+    }
+
+    // Keep the load factor at or below one half.
+    size_t slot_count = 16;
+    while (slot_count < (2 * capacity)) {
+        slot_count <<= 1;
+    }
+
+    uparse_intern_t *intern = (uparse_intern_t *) malloc(sizeof(uparse_intern_t));
+    if (NULL == intern) {
+        fprintf(stderr,"cannot allocate intern\n");
+        return NULL;
+    }
+    intern->slots = (_Atomic(intern_entry_t *) *) malloc(slot_count * sizeof(*intern->slots));
+    intern->by_id = (_Atomic(intern_entry_t *) *) malloc((capacity + 1) * sizeof(*intern->by_id));
+    if ((NULL == intern->slots) || (NULL == intern->by_id)) {
+        fprintf(stderr,"cannot allocate intern slots\n");
+        free(intern->slots);
+        free(intern->by_id);
+        free(intern);
+        return NULL;
+    }
+    for (size_t i = 0; i < slot_count; i++) {
+        atomic_init(&intern->slots[i],NULL);
+    }
+    for (size_t i = 0; i <= capacity; i++) {
+        atomic_init(&intern->by_id[i],NULL);
+    }
+    intern->mask     = slot_count - 1;
+    intern->capacity = capacity;
+    atomic_init(&intern->count,0);
+    if (0 != pthread_mutex_init(&intern->lock,NULL)) {
+        fprintf(stderr,"cannot init intern lock\n");
+        free(intern->slots);
+        free(intern->by_id);
+        free(intern);
+        return NULL;
+    }
+    return intern;
+}
+
+// Free the table and every string in it. No url_t that points into the
+// table may be used after this.
+UPARSE_DEF void uparse_intern_free(uparse_intern_t *intern) {
+    if (NULL == intern) {
+        return;
+    }
+    for (size_t i = 0; i <= intern->mask; i++) {
+        free(atomic_load_explicit(&intern->slots[i],memory_order_relaxed));
+    }
+    pthread_mutex_destroy(&intern->lock);
+    free(intern->slots);
+    free(intern->by_id);
+    free(intern);
+}
+
+// Probe for s. Returns the matching entry, or NULL with *slot_out set to
+// the empty slot where s would go.
+static intern_entry_t *intern_probe(uparse_intern_t *intern,char const *s,size_t len,
+                                    uint64_t hash,size_t *slot_out) {
+    size_t i = (size_t) hash & intern->mask;
+    for (;;) {
+        intern_entry_t *e = atomic_load_explicit(&intern->slots[i],memory_order_acquire);
+        if (NULL == e) {
+            *slot_out = i;
+            return NULL;
+        }
+        if ((e->hash == hash) && (e->len == len) && (0 == memcmp(e->str,s,len))) {
+            return e;
+        }
+        i = (i + 1) & intern->mask;
+    }
+}
+
+// Return the canonical copy of the len bytes at s, adding it to the table
+// if needed, and set *id_out to its id. Returns NULL if the table is full
+// or an allocation fails; *id_out is then NO_INTERN_ID.
+UPARSE_DEF char const *uparse_intern(uparse_intern_t *intern,char const *s,size_t len,unsigned int *id_out) {
+
+    *id_out = NO_INTERN_ID;
+
+    if ((NULL == intern) || (NULL == s)) {
+        return NULL;
+    }
+
+    uint64_t const hash = uparse_fnv1a(s,len);
+    size_t slot = 0;
+
+    // Fast path, no lock.
+    intern_entry_t *e = intern_probe(intern,s,len,hash,&slot);
+    if (NULL != e) {
+        *id_out = e->id;
+        return e->str;
+    }
+
+    pthread_mutex_lock(&intern->lock);
+
+    // Another writer may have added s since we looked.
+    e = intern_probe(intern,s,len,hash,&slot);
+    if (NULL != e) {
+        pthread_mutex_unlock(&intern->lock);
+        *id_out = e->id;
+        return e->str;
+    }
+
+    size_t const count = atomic_load_explicit(&intern->count,memory_order_relaxed);
+    if (intern->capacity == count) {
+        pthread_mutex_unlock(&intern->lock);
+        return NULL;
+    }
+
+    e = (intern_entry_t *) malloc(sizeof(intern_entry_t) + len + 1);
+    if (NULL == e) {
+        pthread_mutex_unlock(&intern->lock);
+        fprintf(stderr,"cannot allocate intern entry\n");
+        return NULL;
+    }
+    e->hash = hash;
+    e->len  = len;
+    e->id   = (unsigned int) (count + 1);
+    memcpy(e->str,s,len);
+    e->str[len] = '\0';
+
+    atomic_store_explicit(&intern->by_id[e->id],e,memory_order_release);
+    atomic_store_explicit(&intern->slots[slot],e,memory_order_release);
+    atomic_store_explicit(&intern->count,count + 1,memory_order_release);
+
+    pthread_mutex_unlock(&intern->lock);
+
+    *id_out = e->id;
+    return e->str;
+}
+
+// Map an id back to its string. Returns NULL for unknown ids.
+UPARSE_DEF char const *uparse_intern_lookup_id(uparse_intern_t *intern,unsigned int id) {
+    if ((NULL == intern) || (NO_INTERN_ID == id) || (id > intern->capacity)) {
+        return NULL;
+    }
+    intern_entry_t *e = atomic_load_explicit(&intern->by_id[id],memory_order_acquire);
+    return (NULL == e) ? NULL : e->str;
+}
+
+// Number of distinct strings in the table.
+UPARSE_DEF size_t uparse_intern_count(uparse_intern_t *intern) {
+    if (NULL == intern) {
+        return 0;
+    }
+    return atomic_load_explicit(&intern->count,memory_order_acquire);
+}
+
+
 // -----------------------------------------
 // SCHEME PARSING
 
-// Get the protocol scheme, and advance past the expected ://
-// Every url has a scheme. If this returns NULL, it is an error
+// Known schemes, indexed by uparse_scheme_t.
+
+static char const *const SCHEME_NAMES[UPARSE_SCHEME_COUNT] =
+    {NULL,"http","https","ws","wss","ftp","ftps","sftp","ssh","file",
+     "git","telnet","gopher","nntp","ldap","ldaps","rtsp"};
+static unsigned int const SCHEME_DEFAULT_PORTS[UPARSE_SCHEME_COUNT] =
+    {0,80,443,80,443,21,990,22,22,0,
+     9418,23,70,119,389,636,554};
+
+// Compare the len alpha chars at s to the lowercase literal lit, ignoring case.
+// Setting 0x20 lowercases an ascii letter, and s is known to be all letters.
+static bool scheme_eq(char const *s,char const *lit,size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if ((s[i] | 0x20) != lit[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Map the len alpha chars at s to a known scheme. Switches on the length
+// and first char so at most a couple of literals are compared.
+
+UPARSE_DEF uparse_scheme_t uparse_scheme_lookup(char const *s,size_t len) {
+    if ((NULL == s) || (0 == len)) {
+        return UPARSE_SCHEME_UNKNOWN;
+    }
+    uparse_scheme_t candidate = UPARSE_SCHEME_UNKNOWN;
+    char const first = s[0] | 0x20;
+    switch (len) {
+    case 2:
+        candidate = ('w' == first) ? UPARSE_SCHEME_WS : UPARSE_SCHEME_UNKNOWN;
+        break;
+    case 3:
+        switch (first) {
+        case 'w': candidate = UPARSE_SCHEME_WSS; break;
+        case 'f': candidate = UPARSE_SCHEME_FTP; break;
+        case 's': candidate = UPARSE_SCHEME_SSH; break;
+        case 'g': candidate = UPARSE_SCHEME_GIT; break;
+        default: break;
+        }
+        break;
+    case 4:
+        switch (first) {
+        case 'h': candidate = UPARSE_SCHEME_HTTP; break;
+        case 'f':
+            candidate = ('i' == (s[1] | 0x20)) ? UPARSE_SCHEME_FILE : UPARSE_SCHEME_FTPS;
+            break;
+        case 's': candidate = UPARSE_SCHEME_SFTP; break;
+        case 'n': candidate = UPARSE_SCHEME_NNTP; break;
+        case 'l': candidate = UPARSE_SCHEME_LDAP; break;
+        case 'r': candidate = UPARSE_SCHEME_RTSP; break;
+        default: break;
+        }
+        break;
+    case 5:
+        switch (first) {
+        case 'h': candidate = UPARSE_SCHEME_HTTPS; break;
+        case 'l': candidate = UPARSE_SCHEME_LDAPS; break;
+        default: break;
+        }
+        break;
+    case 6:
+        switch (first) {
+        case 't': candidate = UPARSE_SCHEME_TELNET; break;
+        case 'g': candidate = UPARSE_SCHEME_GOPHER; break;
+        default: break;
+        }
+        break;
+    default:
+        break;
+    }
+    if ((UPARSE_SCHEME_UNKNOWN != candidate) && scheme_eq(s,SCHEME_NAMES[candidate],len)) {
+        return candidate;
+    }
+    return UPARSE_SCHEME_UNKNOWN;
+}
+
+// The lowercase name of a known scheme, NULL for unknown ones.
+
+UPARSE_DEF char const *uparse_scheme_name(uparse_scheme_t scheme) {
+    if (scheme >= UPARSE_SCHEME_COUNT) {
+        return NULL;
+    }
+    return SCHEME_NAMES[scheme];
+}
+
+// The well known port of a scheme, 0 if there is none.
+
+UPARSE_DEF unsigned int uparse_scheme_default_port(uparse_scheme_t scheme) {
+    if (scheme >= UPARSE_SCHEME_COUNT) {
+        return 0;
+    }
+    return SCHEME_DEFAULT_PORTS[scheme];
+}
 
-static char *get_protocol_scheme(char const **s, unsigned int *err_out) {
+// Find the protocol scheme, and advance past the expected ://
+// Every url has a scheme. If this returns NULL, it is an error. Otherwise
+// the scheme is the *len_out chars at the returned pointer, which points
+// into the input.
+
+static char const *scan_protocol_scheme(char const **s, size_t *len_out, unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR;
 
@@ -112,17 +495,16 @@ static char *get_protocol_scheme(char const **s, unsigned int *err_out) {
 
     // Local copy we can advance.
     char const *c = *s;
+    char const *const scheme = c;
 
     // Choose a sensible limit for a scheme.
-    size_t const max_scheme_len = 16;
-    char scheme[max_scheme_len+1];
-    memset(&scheme[0], 0, sizeof(scheme));
+    size_t const max_scheme_len = UPARSE_MAX_SCHEME_LEN;
 
     size_t j = 0;
 
     bool seen_prefix = false;
 
-    // Copy alpha characters preceeding the ':'
+    // Accept alpha characters preceeding the ':'
     while (*c) {
         if (SCHEME_DELIM_PREFIX == c[0]) {
             seen_prefix = true;
@@ -135,8 +517,6 @@ static char *get_protocol_scheme(char const **s, unsigned int *err_out) {
         } else if (max_scheme_len == j) {
             fprintf(stderr,"scheme exceeds max scheme len %lu\n",max_scheme_len);
             return NULL;
-        } else {
-            scheme[j] = c[0];
         }
         c++;
         j++;
@@ -172,20 +552,221 @@ static char *get_protocol_scheme(char const **s, unsigned int *err_out) {
     // Advance pointer past all of the scheme chars and delims.
     *s = c;
 
-    scheme[j] = '\0';
+    *len_out = j;
     *err_out = NO_UPARSE_ERROR;
-    return strdup(scheme);
+    return scheme;
 }
 
 
 // -----------------------------------------
 // HOST PARSING
 
-// Get the host section of the url. Doesn't support ipv6, unicode hosts,
-// username annotations etc.
-// Every url must have a host. If this returns NULL, it is an error.
+// Per-byte masks for the SWAR checks below.
+#define BYTES_01 0x0101010101010101ULL
+#define BYTES_80 0x8080808080808080ULL
+
+// High bit set in each byte of w that is '.'. Exact for every byte.
+static uint64_t swar_dot_mask(uint64_t w) {
+    uint64_t const t = w ^ (BYTES_01 * '.');
+    return ~(((t & ~BYTES_80) + ~BYTES_80) | t) & BYTES_80;
+}
+
+// High bit set in each byte of w that is '0'..'9'. w must be ascii, so
+// adding 0x50 or 0x46 to a byte cannot carry into the next one.
+static uint64_t swar_digit_mask(uint64_t w) {
+    uint64_t const ge_0 = (w + (BYTES_01 * 0x50)) & BYTES_80;
+    uint64_t const le_9 = ~(w + (BYTES_01 * 0x46)) & BYTES_80;
+    return ge_0 & le_9;
+}
+
+// Parse the len chars at s as a dotted quad like 10.0.0.1 into *addr_out, in
+// host byte order. The whole literal fits in two 64 bit words, so the chars
+// are classified eight at a time: every byte must be a digit or a '.', and
+// there must be exactly three dots. Only then are the octets accumulated,
+// rejecting empty octets, leading zeros and values over 255.
+
+UPARSE_DEF bool uparse_parse_ipv4(char const *s,size_t len,uint32_t *addr_out) {
+
+    // "0.0.0.0" to "255.255.255.255"
+    if ((len < 7) || (len > 15) || (s[0] < '0') || (s[0] > '9')) {
+        return false;
+    }
+
+    // Pad with '0' so the unused bytes always classify as digits.
+    char buf[16];
+    memset(buf,'0',sizeof(buf));
+    memcpy(buf,s,len);
+    uint64_t w[2];
+    memcpy(w,buf,sizeof(w));
+
+    if (0 != ((w[0] | w[1]) & BYTES_80)) {
+        return false;
+    }
+    uint64_t const dots[2] = {swar_dot_mask(w[0]),swar_dot_mask(w[1])};
+    if (BYTES_80 != ((dots[0] | swar_digit_mask(w[0])) & (dots[1] | swar_digit_mask(w[1])))) {
+        return false;
+    }
+    // Sum the dot bits into the top byte.
+    if (3 != ((((dots[0] >> 7) + (dots[1] >> 7)) * BYTES_01) >> 56)) {
+        return false;
+    }
+
+    uint32_t addr = 0;
+    unsigned int octet = 0;
+    size_t digits = 0;
+    for (size_t i = 0; i <= len; i++) {
+        if ((len == i) || (DOMAIN_DELIM == s[i])) {
+            if ((0 == digits) || (octet > 255)) {
+                return false;
+            }
+            addr = (addr << 8) | octet;
+            octet = 0;
+            digits = 0;
+        } else {
+            if (((1 == digits) && (0 == octet)) || (3 == digits)) {
+                return false;
+            }
+            octet = (octet * 10) + (unsigned int) (s[i] - '0');
+            digits++;
+        }
+    }
+
+    *addr_out = addr;
+    return true;
+}
+
+// Value of the hex digit c, or -1.
+
+static int hex_value(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    char const lower = c | 0x20;
+    if ((lower >= 'a') && (lower <= 'f')) {
+        return lower - 'a' + 10;
+    }
+    return -1;
+}
+
+// Parse an ipv6 address from the start of s, stopping at the first char that
+// cannot be part of one. Groups are read a hex digit at a time straight into
+// their values, "::" is expanded once all groups are known, and a dotted quad
+// is accepted as the last 32 bits. Returns the number of chars consumed, or
+// 0 if they are not a valid address.
+
+static size_t parse_ipv6_prefix(char const *s,uint8_t addr_out[16]) {
+
+    uint16_t groups[8];
+    size_t n = 0;
+    size_t gap = 8;
+    size_t i = 0;
+
+    if ((':' == s[0]) && (':' == s[1])) {
+        gap = 0;
+        i = 2;
+    }
+
+    for (;;) {
+        size_t const start = i;
+        unsigned int val = 0;
+        int h = 0;
+        while ((i - start < 4) && (0 <= (h = hex_value(s[i])))) {
+            val = (val << 4) | (unsigned int) h;
+            i++;
+        }
+
+        if (DOMAIN_DELIM == s[i]) {
+            // An ipv4 tail: back up and parse the whole dotted quad.
+            size_t end = start;
+            while (isdigit((unsigned char) s[end]) || (DOMAIN_DELIM == s[end])) {
+                end++;
+            }
+            uint32_t v4 = 0;
+            if ((n > 6) || !uparse_parse_ipv4(s + start,end - start,&v4)) {
+                return 0;
+            }
+            groups[n++] = (uint16_t) (v4 >> 16);
+            groups[n++] = (uint16_t) (v4 & 0xFFFF);
+            i = end;
+            break;
+        }
+
+        if (start == i) {
+            // Nothing after a "::" is fine, nothing anywhere else is not.
+            if ((gap == n) && (2 <= i) && (':' == s[i - 1]) && (':' == s[i - 2])) {
+                break;
+            }
+            return 0;
+        }
+        if (8 == n) {
+            return 0;
+        }
+        groups[n++] = (uint16_t) val;
+
+        if (':' != s[i]) {
+            break;
+        }
+        i++;
+        if (':' == s[i]) {
+            if (8 != gap) {
+                return 0;
+            }
+            gap = n;
+            i++;
+        }
+    }
+
+    if (((8 == gap) && (8 != n)) || ((8 != gap) && (n > 7))) {
+        return 0;
+    }
+
+    // Expand the "::" into the zero groups it stands for.
+    size_t const zeros = 8 - n;
+    size_t k = 0;
+    for (size_t g = 0; g < 8; g++) {
+        uint16_t v = 0;
+        if ((8 == gap) || (g < gap)) {
+            v = groups[k++];
+        } else if (g >= gap + zeros) {
+            v = groups[k++];
+        }
+        addr_out[2 * g]       = (uint8_t) (v >> 8);
+        addr_out[(2 * g) + 1] = (uint8_t) (v & 0xFF);
+    }
+    return i;
+}
+
+// Parse the len chars at s (without brackets) as an ipv6 address into
+// addr_out, in network byte order. Zone ids are not supported.
+
+UPARSE_DEF bool uparse_parse_ipv6(char const *s,size_t len,uint8_t addr_out[16]) {
+    // Longest form is eight groups of four or six groups and a dotted quad.
+    char buf[48];
+    if ((NULL == s) || (len < 2) || (len >= sizeof(buf))) {
+        return false;
+    }
+    memcpy(buf,s,len);
+    buf[len] = '\0';
+    uint8_t addr[16];
+    if (len != parse_ipv6_prefix(buf,addr)) {
+        return false;
+    }
+    memcpy(addr_out,addr,sizeof(addr));
+    return true;
+}
+
+// Find the host section of the url. Doesn't support username annotations
+// etc. A bracketed ipv6 literal ("[::1]") is parsed into binary as it is
+// scanned, and a name that is an ipv4 literal is recognized once scanned;
+// if url is not NULL its host_kind and address are set accordingly.
+// Every url must have a host. If this returns NULL, it is an error. Otherwise
+// the host is the *len_out chars at the returned pointer, which points
+// into the input. Which chars a host name may have is set by classes, so
+// the policy decides whether utf-8 hosts (bytes over 0x7f) are accepted:
+// UPARSE_POLICY_LENIENT takes them as they are, without punycode.
 
-char *get_host(char const **s, unsigned int *err_out) {
+static char const *scan_host(char const **s, size_t *len_out, url_t *url, uint8_t const *classes,
+                             unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR;
 
@@ -196,11 +777,37 @@ char *get_host(char const **s, unsigned int *err_out) {
 
     // Local copy we can advance.
     char const *c = *s;
+    char const *const host = c;
+
+    if (IPV6_OPEN == c[0]) {
+        uint8_t addr[16];
+        size_t const len = parse_ipv6_prefix(c + 1,addr);
+        c += 1 + len;
+        if ((0 == len) || (IPV6_CLOSE != c[0])) {
+            fprintf(stderr,"host has invalid ipv6 literal\n");
+            return NULL;
+        }
+        c++;
+        if (!(('\0'            == c[0]) ||
+              (HOST_PORT_DELIM == c[0]) ||
+              (PATH_DELIM      == c[0]) ||
+              (QUERY_DELIM     == c[0]) ||
+              (FRAGMENT_DELIM  == c[0]))) {
+            fprintf(stderr,"host has invalid char '%c' after ipv6 literal\n",c[0]);
+            return NULL;
+        }
+        if (NULL != url) {
+            url->host_kind = UPARSE_HOST_IPV6;
+            memcpy(url->ipv6,addr,sizeof(addr));
+        }
+        *s = c;
+        *len_out = (size_t) (c - host);
+        *err_out = NO_UPARSE_ERROR;
+        return host;
+    }
 
     // Choose a sensible limit for a host.
-    size_t const max_host_len = 128;
-    char host[max_host_len+1];
-    memset(&host[0], 0, sizeof(host));
+    size_t const max_host_len = UPARSE_MAX_HOST_LEN;
 
     size_t j = 0;
 
@@ -211,14 +818,12 @@ char *get_host(char const **s, unsigned int *err_out) {
             (QUERY_DELIM     == c[0]) ||
             (FRAGMENT_DELIM  == c[0])) {
             break;
-        } else if (!(isalnum(c[0]) || (DOMAIN_DELIM == c[0]))) {
+        } else if (!char_in_class(classes,c[0],UPARSE_CLASS_HOST)) {
             fprintf(stderr,"host has invalid char '%c'\n",c[0]);
             return NULL;
         } else if (max_host_len == j) {
             fprintf(stderr,"host exceeds max host len %lu\n",max_host_len);
             return NULL;
-        } else {
-            host[j] = c[0];
         }
         c++;
         j++;
@@ -230,12 +835,27 @@ char *get_host(char const **s, unsigned int *err_out) {
         return NULL;
     }
 
+    if ((NULL != url) && uparse_parse_ipv4(host,j,&url->ipv4)) {
+        url->host_kind = UPARSE_HOST_IPV4;
+    }
+
     // Advance pointer past the host.
     *s = c;
 
-    host[j] = '\0';
+    *len_out = j;
     *err_out = NO_UPARSE_ERROR;
-    return strdup(host);
+    return host;
+}
+
+// Get the host section of the url as a new string.
+
+UPARSE_DEF char *get_host(char const **s, uint8_t const *classes, unsigned int *err_out) {
+    size_t len = 0;
+    char const *const host = scan_host(s,&len,NULL,classes,err_out);
+    if (NULL == host) {
+        return NULL;
+    }
+    return strndup(host,len);
 }
 
 
@@ -249,7 +869,7 @@ char *get_host(char const **s, unsigned int *err_out) {
 // unsigned int, so in the case of an error, we can return
 // ERROR_PORT (-1), which cannot be assigned to the port part of url_t.
 
-int get_port(char const **s, unsigned int *err_out) {
+UPARSE_DEF int get_port(char const **s, unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR;
 
@@ -279,7 +899,7 @@ int get_port(char const **s, unsigned int *err_out) {
     c++;
 
     // Choose a sensible limit for a port string.
-    size_t const max_port_chars_len = 6;
+    size_t const max_port_chars_len = UPARSE_MAX_PORT_LEN;
     char port_chars[max_port_chars_len+1];
     memset(&port_chars[0], 0, sizeof(port_chars));
 
@@ -334,7 +954,7 @@ int get_port(char const **s, unsigned int *err_out) {
 // A url does not need to have a path, so this can return NULL without an error
 // being thrown
 
-char *get_path(char const **s, unsigned int *err_out) {
+UPARSE_DEF char *get_path(char const **s, uint8_t const *classes, unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR;
 
@@ -361,7 +981,7 @@ char *get_path(char const **s, unsigned int *err_out) {
     c++;
 
     // Choose a sensible limit for a path string.
-    size_t const max_path_len = 1024;
+    size_t const max_path_len = UPARSE_MAX_PATH_LEN;
     char path[max_path_len+1];
     memset(&path[0], 0, sizeof(path));
 
@@ -375,8 +995,8 @@ char *get_path(char const **s, unsigned int *err_out) {
         if ((QUERY_DELIM    == c[0]) ||
             (FRAGMENT_DELIM == c[0])) {
             break;
-        } else if (!(isalnum(c[0]) || (PATH_DELIM == c[0]))) {
-            fprintf(stderr,"path char '%c' is not a alphanumeric or /\n",c[0]);
+        } else if (!char_in_class(classes,c[0],UPARSE_CLASS_PATH)) {
+            fprintf(stderr,"path has invalid char '%c'\n",c[0]);
             return NULL;
         } else if (max_path_len == j) {
             fprintf(stderr,"path str exceeds max path str len %lu\n",max_path_len);
@@ -395,6 +1015,123 @@ char *get_path(char const **s, unsigned int *err_out) {
     return strdup(path);
 }
 
+// Start walking the segments of path, which ends at a NUL, '?' or '#'.
+// "/a/b" has the segments "a" and "b", "/a/" has "a" and "" and the
+// vacuous path "/" (or an empty path) has none.
+
+UPARSE_DEF void uparse_path_iter_init(uparse_path_iter_t *iter,char const *path) {
+    uparse_path_iter_init_ex(iter,path,UPARSE_DEFAULT_POLICY);
+}
+
+// Start walking the segments of path, allowing the chars of policy. An
+// unknown policy returns false, and the iterator then has no segments.
+
+UPARSE_DEF bool uparse_path_iter_init_ex(uparse_path_iter_t *iter,char const *path,uparse_policy_t policy) {
+    iter->classes = uparse_char_classes(policy);
+    if (NULL == iter->classes) {
+        fprintf(stderr,"unknown policy %u\n",(unsigned int) policy);
+        iter->c = NULL;
+        iter->first = true;
+        return false;
+    }
+    iter->c = path;
+    iter->first = true;
+    return true;
+}
+
+// Set *seg_out to the next segment and return true, or return false when
+// there are no more. The path is validated as it is walked; on an invalid
+// char this returns false with *err_out set to UPARSE_ERROR.
+
+UPARSE_DEF bool uparse_path_iter_next(uparse_path_iter_t *iter,uparse_span_t *seg_out,unsigned int *err_out) {
+
+    *err_out = NO_UPARSE_ERROR;
+
+    char const *c = iter->c;
+    if ((NULL == c) || ('\0' == c[0]) || (QUERY_DELIM == c[0]) || (FRAGMENT_DELIM == c[0])) {
+        iter->c = NULL;
+        return false;
+    }
+
+    if (PATH_DELIM != c[0]) {
+        fprintf(stderr,"path does not start with %c\n",PATH_DELIM);
+        *err_out = UPARSE_ERROR;
+        iter->c = NULL;
+        return false;
+    }
+
+    // Advance past the '/'
+    c++;
+    char const *const seg = c;
+
+    while (*c) {
+        if ((PATH_DELIM     == c[0]) ||
+            (QUERY_DELIM    == c[0]) ||
+            (FRAGMENT_DELIM == c[0])) {
+            break;
+        } else if (!char_in_class(iter->classes,c[0],UPARSE_CLASS_PATH)) {
+            fprintf(stderr,"path has invalid char '%c'\n",c[0]);
+            *err_out = UPARSE_ERROR;
+            iter->c = NULL;
+            return false;
+        }
+        c++;
+    }
+
+    // The vacuous path has no segments.
+    if (iter->first && (c == seg) && (PATH_DELIM != c[0])) {
+        iter->c = NULL;
+        return false;
+    }
+
+    iter->first = false;
+    iter->c = c;
+    seg_out->ptr = seg;
+    seg_out->len = (size_t) (c - seg);
+    return true;
+}
+
+// Split path into segments, validating it as it is split. This is a pass of
+// its own over a path string such as url->path, not part of parse_url's
+// scan, so a parsed url's path is read twice. Up to cap segments are stored
+// in segs and the number stored is returned; the number of segments that
+// did not fit is stored in *overflow_out.
+
+UPARSE_DEF size_t get_path_segments(char const *path,uparse_span_t *segs,size_t cap,size_t *overflow_out,
+                                    unsigned int *err_out) {
+    return get_path_segments_ex(path,segs,cap,overflow_out,UPARSE_DEFAULT_POLICY,err_out);
+}
+
+// Split path into segments as get_path_segments does, allowing the chars
+// of policy.
+
+UPARSE_DEF size_t get_path_segments_ex(char const *path,uparse_span_t *segs,size_t cap,size_t *overflow_out,
+                                       uparse_policy_t policy,unsigned int *err_out) {
+
+    *overflow_out = 0;
+
+    uparse_path_iter_t iter;
+    if (!uparse_path_iter_init_ex(&iter,path,policy)) {
+        *err_out = UPARSE_ERROR;
+        return 0;
+    }
+
+    size_t j = 0;
+    uparse_span_t seg;
+    while (uparse_path_iter_next(&iter,&seg,err_out)) {
+        if (j < cap) {
+            segs[j++] = seg;
+        } else {
+            (*overflow_out)++;
+        }
+    }
+    if (NO_UPARSE_ERROR != *err_out) {
+        *overflow_out = 0;
+        return 0;
+    }
+    return j;
+}
+
 
 // -----------------------------------------
 // QUERY PARSING
@@ -402,7 +1139,7 @@ char *get_path(char const **s, unsigned int *err_out) {
 // A url doesn't have to have a ?query arg list, so this can return NULL
 // and not be an error.
 
-char *get_query(char const **s, unsigned int *err_out) {
+UPARSE_DEF char *get_query(char const **s, uint8_t const *classes, unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR;
 
@@ -430,7 +1167,7 @@ char *get_query(char const **s, unsigned int *err_out) {
     c++;
 
     // Choose a sensible limit for a query string.
-    size_t const max_query_len = 1024;
+    size_t const max_query_len = UPARSE_MAX_QUERY_LEN;
     char query[max_query_len+1];
     memset(&query[0], 0, sizeof(query));
 
@@ -439,8 +1176,8 @@ char *get_query(char const **s, unsigned int *err_out) {
     while (*c) {
         if (FRAGMENT_DELIM == c[0]) {
             break;
-        } else if (!(isalnum(c[0]) || (QUERY_PAIR_DELIM == c[0]) || (QUERY_KEY_VAL_DELIM == c[0]))) {
-            fprintf(stderr,"query char '%c' is not a alphanumeric or =\n",c[0]);
+        } else if (!char_in_class(classes,c[0],UPARSE_CLASS_QUERY)) {
+            fprintf(stderr,"query has invalid char '%c'\n",c[0]);
             return NULL;
         } else if (max_query_len == j) {
             fprintf(stderr,"query str exceeds max query str len %lu\n",max_query_len);
@@ -460,7 +1197,7 @@ char *get_query(char const **s, unsigned int *err_out) {
 }
 
 // query_key_val_t destructor.
-void free_query_key_val_t(query_key_val_t *query_key_val) {
+UPARSE_DEF void free_query_key_val_t(query_key_val_t *query_key_val) {
     if (NULL == query_key_val) {
         return;
     }
@@ -474,7 +1211,7 @@ void free_query_key_val_t(query_key_val_t *query_key_val) {
 }
 
 // query_key_val list destructor.
-void free_query_key_val_t_list(query_key_val_t **query_key_vals,size_t len) {
+UPARSE_DEF void free_query_key_val_t_list(query_key_val_t **query_key_vals,size_t len) {
     if (NULL == query_key_vals) {
         return;
     }
@@ -485,7 +1222,7 @@ void free_query_key_val_t_list(query_key_val_t **query_key_vals,size_t len) {
 }
 
 // query_arg_list destructor.
-void free_arg_list_t(query_arg_list_t *query_arg_list) {
+UPARSE_DEF void free_arg_list_t(query_arg_list_t *query_arg_list) {
     if (NULL == query_arg_list) {
         return;
     }
@@ -495,7 +1232,7 @@ void free_arg_list_t(query_arg_list_t *query_arg_list) {
 
 // Parse the query string part of a url and turn it into q query_arg_list_t, which
 // is a list of query_key_val_t structs and a count.
-query_arg_list_t *get_query_arg_list(char *const query_str, unsigned int *err_out) {
+UPARSE_DEF query_arg_list_t *get_query_arg_list(char *const query_str, unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR; 
     
@@ -731,7 +1468,7 @@ query_arg_list_t *get_query_arg_list(char *const query_str, unsigned int *err_ou
 // No special destructor needed, fragment is just char *. A url does not need to have
 // a fragment, so a NULL return value is not strictly an error.
 
-char *get_fragment(char const **s, unsigned int *err_out) {
+UPARSE_DEF char *get_fragment(char const **s, uint8_t const *classes, unsigned int *err_out) {
 
     *err_out = UPARSE_ERROR;
 
@@ -759,15 +1496,15 @@ char *get_fragment(char const **s, unsigned int *err_out) {
     c++;
 
     // Choose a sensible limit for a fragment string.
-    size_t const max_fragment_len = 1024;
+    size_t const max_fragment_len = UPARSE_MAX_FRAGMENT_LEN;
     char fragment[max_fragment_len+1];
     memset(&fragment[0], 0, sizeof(fragment));
 
     size_t j = 0;
 
     while (*c) {
-        if (!isalnum(c[0])) {
-            fprintf(stderr,"fragment char '%c' is not a alphanumeric or =\n",c[0]);
+        if (!char_in_class(classes,c[0],UPARSE_CLASS_FRAGMENT)) {
+            fprintf(stderr,"fragment has invalid char '%c'\n",c[0]);
             return NULL;
         } else if (max_fragment_len == j) {
             fprintf(stderr,"fragment str exceeds max fragment str len %lu\n",max_fragment_len);
@@ -790,56 +1527,138 @@ char *get_fragment(char const **s, unsigned int *err_out) {
 // -----------------------------------------
 // URL PARSING
 
-// main function for parsing a string url into a url struct
+// Copy a scanned component into a url, through the intern table if there
+// is one. A full intern table is not an error, the url just gets its own copy.
 
-url_t *parse_url(char const *const url_string,unsigned int *err_out) {
+static char *intern_or_copy(uparse_intern_t *intern,char const *s,size_t len,unsigned int *id_out) {
+    *id_out = NO_INTERN_ID;
+    if (NULL != intern) {
+        char const *const canon = uparse_intern(intern,s,len,id_out);
+        if (NULL != canon) {
+            return (char *) canon;
+        }
+    }
+    return strndup(s,len);
+}
 
-    *err_out = NO_UPARSE_ERROR;
+// Fill in the path, query and fragment of url from *s. Only a missing or
+// bad path is fatal: a bad query or fragment is left out of the url and
+// reported in *err_out.
 
-    url_t *url = (url_t *) malloc(sizeof(url_t));
-    if (NULL == url) {
-        fprintf(stderr,"cannot allocate url\n");
-        return NULL;
-    }
-    init_url_t(url);
+static bool get_path_query_fragment(char const **s,url_t *url,char const *const url_string,
+                                    uint8_t const *classes,unsigned int *err_out) {
 
-    // get a mutable pointer to the url string, and set a copy that can be freed
-    char const *s = strdup(url_string);
-    if (NULL == s) {
-        fprintf(stderr,"cannot copy url_string\n");
-        free_url_t(url);
-        return NULL;
+    char *path = get_path(s,classes,err_out);
+    if (NULL == path) {
+        fprintf(stderr,"cannot get path from %s\n",url_string);
+        return false;
     }
-    char const *const free_s = s;
-    
-    char *scheme = get_protocol_scheme(&s,err_out);
-    if (NULL == scheme) {
-        fprintf(stderr,"cannot get scheme from %s\n",url_string);
-        free_url_t(url);
-        free((void *) free_s);
+    if (NO_UPARSE_ERROR != *err_out) {
+        fprintf(stderr,"cannot get path from %s\n",url_string);
+        free(path);
+        return false;
+    }
+    url->path = path;
+
+    char *query = get_query(s,classes,err_out);
+    if ((NULL != query) && (UPARSE_ERROR != *err_out)) {
+        url->query = query;
+    }
+    
+    char *fragment = get_fragment(s,classes,err_out);
+    if ((NULL != fragment) && (UPARSE_ERROR != *err_out)) {
+        url->fragment = fragment;
+    }
+    return true;
+}
+
+// main function for parsing a string url into a url struct
+
+UPARSE_DEF url_t *parse_url(char const *const url_string,unsigned int *err_out) {
+    return parse_url_interned(url_string,NULL,err_out);
+}
+
+// parse a string url into a url struct, resolving the scheme and host
+// through intern (which may be NULL)
+
+UPARSE_DEF url_t *parse_url_interned(char const *const url_string,uparse_intern_t *intern,unsigned int *err_out) {
+    return parse_url_ex(url_string,intern,UPARSE_DEFAULT_POLICY,err_out);
+}
+
+// parse a string url into a url struct, resolving the scheme and host
+// through intern (which may be NULL) and allowing the chars of policy
+
+UPARSE_DEF url_t *parse_url_ex(char const *const url_string,uparse_intern_t *intern,uparse_policy_t policy,
+                               unsigned int *err_out) {
+
+    *err_out = NO_UPARSE_ERROR;
+
+    uint8_t const *const classes = uparse_char_classes(policy);
+    if (NULL == classes) {
+        fprintf(stderr,"unknown policy %u\n",(unsigned int) policy);
+        *err_out = UPARSE_ERROR;
         return NULL;
     }
-    if (NO_UPARSE_ERROR != *err_out) {
+
+    url_t *url = (url_t *) malloc(sizeof(url_t));
+    if (NULL == url) {
+        fprintf(stderr,"cannot allocate url\n");
+        return NULL;
+    }
+    init_url_t(url);
+
+    // get a mutable pointer to the url string, and set a copy that can be freed
+    char const *s = strdup(url_string);
+    if (NULL == s) {
+        fprintf(stderr,"cannot copy url_string\n");
+        free_url_t(url);
+        return NULL;
+    }
+    char const *const free_s = s;
+    
+    size_t scheme_len = 0;
+    char const *const scheme_start = scan_protocol_scheme(&s,&scheme_len,err_out);
+    if ((NULL == scheme_start) || (NO_UPARSE_ERROR != *err_out)) {
         fprintf(stderr,"cannot get scheme from %s\n",url_string);
         free_url_t(url);
         free((void *) free_s);
-        free(scheme);
+        return NULL;
+    }
+    url->scheme_kind = uparse_scheme_lookup(scheme_start,scheme_len);
+    url->default_port = uparse_scheme_default_port(url->scheme_kind);
+    char const *scheme = NULL;
+    if (UPARSE_SCHEME_UNKNOWN != url->scheme_kind) {
+        scheme = SCHEME_NAMES[url->scheme_kind];
+    } else {
+        // Schemes are case insensitive; keep unknown ones lowercase like the known.
+        char lower[UPARSE_MAX_SCHEME_LEN];
+        uparse_lowercase(lower,scheme_start,scheme_len);
+        scheme = intern_or_copy(intern,lower,scheme_len,&url->scheme_id);
+    }
+    if (NULL == scheme) {
+        fprintf(stderr,"cannot copy scheme from %s\n",url_string);
+        free_url_t(url);
+        free((void *) free_s);
         return NULL;
     }
     url->scheme = scheme;
 
-    char *host = get_host(&s,err_out);
-    if (NULL == host) {
+    size_t host_len = 0;
+    char const *const host_start = scan_host(&s,&host_len,url,classes,err_out);
+    if ((NULL == host_start) || (NO_UPARSE_ERROR != *err_out)) {
         fprintf(stderr,"cannot get host from %s\n",url_string);
         free_url_t(url);
         free((void *) free_s);
         return NULL;
     }
-    if (NO_UPARSE_ERROR != *err_out) {
-        fprintf(stderr,"cannot get host from %s\n",url_string);
+    // Hosts are case insensitive, so they are kept lowercased. host_start
+    // points into our own copy of url_string.
+    uparse_lowercase((char *) host_start,host_start,host_len);
+    char *host = intern_or_copy(intern,host_start,host_len,&url->host_id);
+    if (NULL == host) {
+        fprintf(stderr,"cannot copy host from %s\n",url_string);
         free_url_t(url);
         free((void *) free_s);
-        free(host);
         return NULL;
     }
     url->host = host;
@@ -859,44 +1678,136 @@ url_t *parse_url(char const *const url_string,unsigned int *err_out) {
     }
     url->port = port;
 
-    char *path = get_path(&s,err_out);
-    if (NULL == path) {
-        fprintf(stderr,"cannot get path from %s\n",url_string);
+    if (!get_path_query_fragment(&s,url,url_string,classes,err_out)) {
         free_url_t(url);
         free((void *) free_s);
         return NULL;
     }
-    if (NO_UPARSE_ERROR != *err_out) {
-        fprintf(stderr,"cannot get path from %s\n",url_string);
-        free_url_t(url);
-        free((void *) free_s);
-        free(path);
+
+    free((void *) free_s);
+    return url;
+}
+
+// Parse an http request-target (RFC 7230 5.3) without gluing a scheme and
+// host onto it first. The form found is stored in *form_out:
+//   origin-form    "/path?query"          only path, query (and fragment) are set
+//   absolute-form  "http://host/path"     parsed as by parse_url
+//   authority-form "host:port"            only host and port are set, for CONNECT
+//   asterisk-form  "*"                    only path is set, to "*", for OPTIONS
+
+UPARSE_DEF url_t *parse_request_target(char const *const target,uparse_target_form_t *form_out,
+                                       unsigned int *err_out) {
+    return parse_request_target_ex(target,UPARSE_DEFAULT_POLICY,form_out,err_out);
+}
+
+// parse an http request-target, allowing the chars of policy
+
+UPARSE_DEF url_t *parse_request_target_ex(char const *const target,uparse_policy_t policy,
+                                          uparse_target_form_t *form_out,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    uint8_t const *const classes = uparse_char_classes(policy);
+    if (NULL == classes) {
+        fprintf(stderr,"unknown policy %u\n",(unsigned int) policy);
         return NULL;
     }
-    url->path = path;
 
-    char *query = get_query(&s,err_out);
-    if ((NULL != query) && (UPARSE_ERROR != *err_out)) {
-        url->query = query;
+    if (NULL == target) {
+        fprintf(stderr,"input target is null\n");
+        return NULL;
     }
-    
-    char *fragment = get_fragment(&s,err_out);
-    if ((NULL != fragment) && (UPARSE_ERROR != *err_out)) {
-        url->fragment = fragment;
+
+    // An absolute-form target starts with a scheme and "://".
+    char const *c = target;
+    while (isalpha(c[0])) {
+        c++;
     }
-    
-    free((void *) free_s);
+    if ((c != target) && (SCHEME_DELIM_PREFIX == c[0]) && (SCHEME_SLASH == c[1])) {
+        *form_out = UPARSE_TARGET_ABSOLUTE;
+        return parse_url_ex(target,NULL,policy,err_out);
+    }
+
+    url_t *url = (url_t *) malloc(sizeof(url_t));
+    if (NULL == url) {
+        fprintf(stderr,"cannot allocate url\n");
+        return NULL;
+    }
+    init_url_t(url);
+
+    char const *s = target;
+
+    if (PATH_DELIM == s[0]) {
+        *form_out = UPARSE_TARGET_ORIGIN;
+        *err_out = NO_UPARSE_ERROR;
+        if (!get_path_query_fragment(&s,url,target,classes,err_out)) {
+            free_url_t(url);
+            return NULL;
+        }
+        return url;
+    }
+
+    // The path "*" keeps the form in the url, so url_format writes "*" back.
+    if ((ASTERISK_TARGET == s[0]) && ('\0' == s[1])) {
+        *form_out = UPARSE_TARGET_ASTERISK;
+        url->path = strdup("*");
+        if (NULL == url->path) {
+            fprintf(stderr,"cannot copy path from %s\n",target);
+            free_url_t(url);
+            return NULL;
+        }
+        *err_out = NO_UPARSE_ERROR;
+        return url;
+    }
+
+    *form_out = UPARSE_TARGET_AUTHORITY;
+
+    size_t host_len = 0;
+    char const *const host_start = scan_host(&s,&host_len,url,classes,err_out);
+    if ((NULL == host_start) || (NO_UPARSE_ERROR != *err_out)) {
+        fprintf(stderr,"cannot get host from %s\n",target);
+        free_url_t(url);
+        return NULL;
+    }
+    url->host = strndup(host_start,host_len);
+    if (NULL == url->host) {
+        fprintf(stderr,"cannot copy host from %s\n",target);
+        free_url_t(url);
+        *err_out = UPARSE_ERROR;
+        return NULL;
+    }
+    uparse_lowercase(url->host,url->host,host_len);
+
+    // The port is required, and nothing may follow it.
+    int const port = get_port(&s,err_out);
+    if ((ERROR_PORT == port) || (NO_PORT == port) || (NO_UPARSE_ERROR != *err_out) || ('\0' != s[0])) {
+        fprintf(stderr,"cannot get port from %s\n",target);
+        free_url_t(url);
+        *err_out = UPARSE_ERROR;
+        return NULL;
+    }
+    url->port = (unsigned int) port;
     return url;
 }
 
 // prints out a url for easy reading
 
-void print_url(url_t *u) {
+UPARSE_DEF void print_url(url_t *u) {
     if (NULL == u) {
         printf("(null)\n");
         return;
     }
-    printf(" [ %s ] :// [ %s ] : [ %u ] [ %s ] ",u->scheme,u->host,u->port,u->path);
+    // A url from parse_request_target may lack any of these.
+    if (NULL != u->scheme) {
+        printf(" [ %s ] ://",u->scheme);
+    }
+    if (NULL != u->host) {
+        printf(" [ %s ] : [ %u ]",u->host,u->port);
+    }
+    if (NULL != u->path) {
+        printf(" [ %s ]",u->path);
+    }
+    printf(" ");
     if (NULL != u->query) {
         printf("? [ %s ] ",u->query);
     }
@@ -906,3 +1817,813 @@ void print_url(url_t *u) {
     printf("\n");
     return;
 }
+
+
+// -----------------------------------------
+// URL FORMATTING
+
+// Whether c starts a %XX escape, which format_component leaves alone so a
+// url parsed from an escaped string is not escaped twice. A '%' not
+// followed by two hex digits is escaped as "%25".
+
+static bool is_escaped(char const *c) {
+    return ('%' == c[0]) && (0 <= hex_value(c[1])) && (0 <= hex_value(c[2]));
+}
+
+// Length of s once written by format_component. keep is a char that is
+// never escaped (such as the '/' in a path), keep2 a second one.
+
+static size_t component_len(char const *s,bool escape,char keep,char keep2) {
+    if (!escape) {
+        return strlen(s);
+    }
+    size_t len = 0;
+    for (char const *c = s; *c; c++) {
+        if (is_escaped(c)) {
+            len += 3;
+            c += 2;
+        } else {
+            len += (needs_escape(*c) && (keep != *c) && (keep2 != *c)) ? 3 : 1;
+        }
+    }
+    return len;
+}
+
+static char *format_component(char *d,char const *s,bool escape,char keep,char keep2) {
+    if (!escape) {
+        size_t const len = strlen(s);
+        memcpy(d,s,len);
+        return d + len;
+    }
+    for (char const *c = s; *c; c++) {
+        if (is_escaped(c)) {
+            memcpy(d,c,3);
+            d += 3;
+            c += 2;
+        } else if (needs_escape(*c) && (keep != *c) && (keep2 != *c)) {
+            d = escape_char(d,*c);
+        } else {
+            *d++ = *c;
+        }
+    }
+    return d;
+}
+
+static size_t port_len(unsigned int port) {
+    size_t len = 1;
+    while (port >= 10) {
+        port /= 10;
+        len++;
+    }
+    return len;
+}
+
+// Write the decimal digits of port at d, returning the end of them.
+
+static char *format_port(char *d,unsigned int port) {
+    size_t const digits = port_len(port);
+    for (size_t i = digits; i > 0; i--) {
+        d[i - 1] = (char) ('0' + (port % 10));
+        port /= 10;
+    }
+    return d + digits;
+}
+
+// Write a url into dst, the inverse of parse_url. The full length (not
+// counting the NUL) is computed first and returned. The url and a NUL are
+// only written if that length is less than cap, so a return value >= cap
+// means dst was too small; in that case dst is set to "" if cap allows.
+// Nothing is formatted through printf.
+
+UPARSE_DEF size_t url_format(url_t const *u,char *dst,size_t cap) {
+    return url_format_ex(u,dst,cap,0);
+}
+
+// url_format, but with UPARSE_FORMAT_ESCAPE set in flags the path, query and
+// fragment are escaped with the url_escape rules, keeping the '/' of the
+// path, the '&' and '=' of the query and any %XX escapes already there.
+
+UPARSE_DEF size_t url_format_ex(url_t const *u,char *dst,size_t cap,unsigned int flags) {
+
+    if (NULL == u) {
+        if (0 < cap) {
+            dst[0] = '\0';
+        }
+        return 0;
+    }
+
+    bool escape = (0 != (flags & UPARSE_FORMAT_ESCAPE));
+
+    // Only an authority-form request target has neither a scheme nor a path.
+    char const *path = u->path;
+    if (NULL == path) {
+        path = ((NULL == u->scheme) && (NULL != u->host)) ? "" : "/";
+    }
+
+    // An asterisk-form request target is written as is, never as "%2A".
+    if ((NULL == u->scheme) && (NULL == u->host) && (ASTERISK_TARGET == path[0]) && ('\0' == path[1])) {
+        escape = false;
+    }
+
+    size_t len = 0;
+    if (NULL != u->scheme) {
+        len += strlen(u->scheme) + 3;
+    }
+    if (NULL != u->host) {
+        len += strlen(u->host);
+        if (NO_PORT != (int) u->port) {
+            len += 1 + port_len(u->port);
+        }
+    }
+    len += component_len(path,escape,PATH_DELIM,PATH_DELIM);
+    if (NULL != u->query) {
+        len += 1 + component_len(u->query,escape,QUERY_PAIR_DELIM,QUERY_KEY_VAL_DELIM);
+    }
+    if (NULL != u->fragment) {
+        len += 1 + component_len(u->fragment,escape,'\0','\0');
+    }
+
+    if (len >= cap) {
+        if (0 < cap) {
+            dst[0] = '\0';
+        }
+        return len;
+    }
+
+    char *d = dst;
+    if (NULL != u->scheme) {
+        d = format_component(d,u->scheme,false,'\0','\0');
+        *d++ = SCHEME_DELIM_PREFIX;
+        *d++ = SCHEME_SLASH;
+        *d++ = SCHEME_SLASH;
+    }
+    if (NULL != u->host) {
+        d = format_component(d,u->host,false,'\0','\0');
+        if (NO_PORT != (int) u->port) {
+            *d++ = HOST_PORT_DELIM;
+            d = format_port(d,u->port);
+        }
+    }
+    d = format_component(d,path,escape,PATH_DELIM,PATH_DELIM);
+    if (NULL != u->query) {
+        *d++ = QUERY_DELIM;
+        d = format_component(d,u->query,escape,QUERY_PAIR_DELIM,QUERY_KEY_VAL_DELIM);
+    }
+    if (NULL != u->fragment) {
+        *d++ = FRAGMENT_DELIM;
+        d = format_component(d,u->fragment,escape,'\0','\0');
+    }
+    *d = '\0';
+    return len;
+}
+
+
+// -----------------------------------------
+// REFERENCE RESOLUTION
+
+// A reference split into its RFC 3986 components. The spans point into the
+// reference string; a component is only defined if its flag is set, since an
+// empty query ("?") is not the same as no query.
+
+typedef struct ref_parts_t {
+    uparse_span_t scheme;
+    uparse_span_t authority;
+    uparse_span_t path;
+    uparse_span_t query;
+    uparse_span_t fragment;
+    bool          has_scheme;
+    bool          has_authority;
+    bool          has_query;
+    bool          has_fragment;
+} ref_parts_t;
+
+static void split_ref(char const *ref,ref_parts_t *r) {
+
+    memset(r,0,sizeof(ref_parts_t));
+    char const *c = ref;
+
+    // A scheme is ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) followed by ':'.
+    if (isalpha(c[0])) {
+        char const *e = c + 1;
+        while (isalnum(e[0]) || ('+' == e[0]) || ('-' == e[0]) || ('.' == e[0])) {
+            e++;
+        }
+        if (SCHEME_DELIM_PREFIX == e[0]) {
+            r->has_scheme = true;
+            r->scheme.ptr = c;
+            r->scheme.len = (size_t) (e - c);
+            c = e + 1;
+        }
+    }
+
+    if ((PATH_DELIM == c[0]) && (PATH_DELIM == c[1])) {
+        c += 2;
+        char const *const a = c;
+        while (*c && (PATH_DELIM != c[0]) && (QUERY_DELIM != c[0]) && (FRAGMENT_DELIM != c[0])) {
+            c++;
+        }
+        r->has_authority = true;
+        r->authority.ptr = a;
+        r->authority.len = (size_t) (c - a);
+    }
+
+    char const *const p = c;
+    while (*c && (QUERY_DELIM != c[0]) && (FRAGMENT_DELIM != c[0])) {
+        c++;
+    }
+    r->path.ptr = p;
+    r->path.len = (size_t) (c - p);
+
+    if (QUERY_DELIM == c[0]) {
+        c++;
+        char const *const q = c;
+        while (*c && (FRAGMENT_DELIM != c[0])) {
+            c++;
+        }
+        r->has_query = true;
+        r->query.ptr = q;
+        r->query.len = (size_t) (c - q);
+    }
+
+    if (FRAGMENT_DELIM == c[0]) {
+        c++;
+        r->has_fragment = true;
+        r->fragment.ptr = c;
+        r->fragment.len = strlen(c);
+    }
+}
+
+// Append len chars to the output, failing if they (and a final NUL) do not fit.
+
+static bool put(char **d,char const *const end,char const *s,size_t len) {
+    if ((size_t) (end - *d) <= len) {
+        return false;
+    }
+    memcpy(*d,s,len);
+    *d += len;
+    return true;
+}
+
+// Remove the last segment, and the '/' before it, from the output path.
+
+static char *pop_segment(char *start,char *out) {
+    while ((out > start) && (PATH_DELIM != out[-1])) {
+        out--;
+    }
+    if (out > start) {
+        out--;
+    }
+    return out;
+}
+
+static bool has_prefix(char const *s,char const *end,char const *prefix) {
+    size_t const len = strlen(prefix);
+    return ((size_t) (end - s) >= len) && (0 == memcmp(s,prefix,len));
+}
+
+// RFC 3986 5.2.4 remove_dot_segments, in place on [start,end). The output
+// is never longer than the input consumed so far, so it can overwrite it.
+// Returns the new end.
+
+static char *remove_dot_segments(char *start,char *end) {
+    char *in = start;
+    char *out = start;
+    while (in < end) {
+        if (has_prefix(in,end,"../")) {
+            in += 3;
+        } else if (has_prefix(in,end,"./")) {
+            in += 2;
+        } else if (has_prefix(in,end,"/./")) {
+            in += 2;
+        } else if ((2 == (end - in)) && has_prefix(in,end,"/.")) {
+            *out++ = PATH_DELIM;
+            in = end;
+        } else if (has_prefix(in,end,"/../")) {
+            in += 3;
+            out = pop_segment(start,out);
+        } else if ((3 == (end - in)) && has_prefix(in,end,"/..")) {
+            out = pop_segment(start,out);
+            *out++ = PATH_DELIM;
+            in = end;
+        } else if (((1 == (end - in)) && ('.' == in[0])) ||
+                   ((2 == (end - in)) && has_prefix(in,end,".."))) {
+            in = end;
+        } else {
+            // Move the first segment, with its leading '/' if any, to the output.
+            char *seg_end = in + ((PATH_DELIM == in[0]) ? 1 : 0);
+            while ((seg_end < end) && (PATH_DELIM != seg_end[0])) {
+                seg_end++;
+            }
+            size_t const len = (size_t) (seg_end - in);
+            memmove(out,in,len);
+            out += len;
+            in = seg_end;
+        }
+    }
+    return out;
+}
+
+// Resolve the reference ref (such as "../img/a.png", "?page=2" or
+// "//cdn.host/x") against base following RFC 3986 section 5.2, and write the
+// result into dst with a NUL. Dot segments are removed in place in dst, so
+// nothing else is allocated. Returns the length of the result; if it does
+// not fit in cap, returns 0 with *err_out set to OVERFLOW_ERROR.
+
+UPARSE_DEF size_t url_resolve(url_t const *base,char const *ref,char *dst,size_t cap,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == base) || (NULL == ref) || (NULL == dst) || (0 == cap)) {
+        fprintf(stderr,"url_resolve needs a base, ref and dst\n");
+        return 0;
+    }
+    if (NULL == base->scheme) {
+        fprintf(stderr,"base url has no scheme\n");
+        return 0;
+    }
+
+    ref_parts_t r;
+    split_ref(ref,&r);
+
+    char *d = dst;
+    char const *const end = dst + cap;
+    bool ok = true;
+
+    // Scheme
+    if (r.has_scheme) {
+        ok = ok && put(&d,end,r.scheme.ptr,r.scheme.len);
+    } else {
+        ok = ok && put(&d,end,base->scheme,strlen(base->scheme));
+    }
+    ok = ok && put(&d,end,":",1);
+
+    // Authority
+    if (r.has_scheme || r.has_authority) {
+        if (r.has_authority) {
+            ok = ok && put(&d,end,"//",2);
+            ok = ok && put(&d,end,r.authority.ptr,r.authority.len);
+        }
+    } else if (NULL != base->host) {
+        ok = ok && put(&d,end,"//",2);
+        ok = ok && put(&d,end,base->host,strlen(base->host));
+        if (NO_PORT != (int) base->port) {
+            // A caller built url may hold any unsigned int port; three
+            // digits per byte is room for the largest.
+            char port[3 * sizeof(unsigned int)];
+            size_t const digits = (size_t) (format_port(port,base->port) - port);
+            ok = ok && put(&d,end,":",1);
+            ok = ok && put(&d,end,port,digits);
+        }
+    }
+
+    // Path and query
+    char const *const base_path = (NULL == base->path) ? "/" : base->path;
+    char *const path_start = d;
+    uparse_span_t query = r.query;
+    bool has_query = r.has_query;
+
+    if (r.has_scheme || r.has_authority || ((0 < r.path.len) && (PATH_DELIM == r.path.ptr[0]))) {
+        ok = ok && put(&d,end,r.path.ptr,r.path.len);
+        if (ok) {
+            d = remove_dot_segments(path_start,d);
+        }
+    } else if (0 == r.path.len) {
+        ok = ok && put(&d,end,base_path,strlen(base_path));
+        if (!has_query && (NULL != base->query)) {
+            has_query = true;
+            query.ptr = base->query;
+            query.len = strlen(base->query);
+        }
+    } else {
+        // Merge: everything in the base path up to its last '/', then the ref.
+        char const *const last = strrchr(base_path,PATH_DELIM);
+        if (NULL == last) {
+            ok = ok && put(&d,end,"/",1);
+        } else {
+            ok = ok && put(&d,end,base_path,(size_t) (last - base_path) + 1);
+        }
+        ok = ok && put(&d,end,r.path.ptr,r.path.len);
+        if (ok) {
+            d = remove_dot_segments(path_start,d);
+        }
+    }
+
+    if (has_query) {
+        ok = ok && put(&d,end,"?",1);
+        ok = ok && put(&d,end,query.ptr,query.len);
+    }
+
+    // Fragment
+    if (r.has_fragment) {
+        ok = ok && put(&d,end,"#",1);
+        ok = ok && put(&d,end,r.fragment.ptr,r.fragment.len);
+    }
+
+    if (!ok) {
+        fprintf(stderr,"resolved %s exceeds %lu chars\n",ref,cap);
+        dst[0] = '\0';
+        *err_out = OVERFLOW_ERROR;
+        return 0;
+    }
+
+    *d = '\0';
+    *err_out = NO_UPARSE_ERROR;
+    return (size_t) (d - dst);
+}
+
+
+// -----------------------------------------
+// INCREMENTAL PARSING
+
+// The push parser applies the same rules as parse_url one char at a time,
+// copying each component into its buffer in the state as it goes, so a url
+// split across any number of chunks never has to be put back together.
+
+enum {
+    FEED_SCHEME = 0,
+    FEED_SCHEME_SLASH,
+    FEED_SLASHES,
+    FEED_HOST_START,
+    FEED_HOST,
+    FEED_IPV6,
+    FEED_IPV6_END,
+    FEED_PORT,
+    FEED_PATH,
+    FEED_QUERY,
+    FEED_FRAGMENT,
+    FEED_DONE,
+    FEED_ERROR
+};
+
+// Chars that end a url that is being fed, as in an http request line.
+
+static bool feed_terminator(char c) {
+    return (' ' == c) || ('\r' == c) || ('\n' == c) || ('\t' == c);
+}
+
+// Start a new url. The component buffers are not cleared, only the
+// lengths, since they are only read up to those.
+
+UPARSE_DEF void uparse_feed_init(uparse_feed_t *f) {
+    uparse_feed_init_ex(f,UPARSE_DEFAULT_POLICY);
+}
+
+// Start a new url allowing the chars of policy. An unknown policy makes
+// the first uparse_feed fail.
+
+UPARSE_DEF void uparse_feed_init_ex(uparse_feed_t *f,uparse_policy_t policy) {
+    f->classes      = uparse_char_classes(policy);
+    f->state        = (NULL == f->classes) ? FEED_ERROR : FEED_SCHEME;
+    f->has_query    = false;
+    f->has_fragment = false;
+    f->port         = 0;
+    f->port_len     = 0;
+    f->scheme_len   = 0;
+    f->host_len     = 0;
+    f->path_len     = 0;
+    f->query_len    = 0;
+    f->fragment_len = 0;
+}
+
+static uparse_feed_status_t feed_fail(uparse_feed_t *f,char const *why,char c) {
+    fprintf(stderr,"%s '%c'\n",why,c);
+    f->state = FEED_ERROR;
+    return UPARSE_FEED_ERROR;
+}
+
+// The url is complete: check that what was read so far is a whole url.
+
+static uparse_feed_status_t feed_end(uparse_feed_t *f) {
+    switch (f->state) {
+    case FEED_HOST:
+    case FEED_IPV6_END:
+    case FEED_PATH:
+    case FEED_QUERY:
+    case FEED_FRAGMENT:
+        f->state = FEED_DONE;
+        return UPARSE_FEED_DONE;
+    case FEED_PORT:
+        if (0 == f->port) {
+            return feed_fail(f,"url ends in an empty or zero port",HOST_PORT_DELIM);
+        }
+        f->state = FEED_DONE;
+        return UPARSE_FEED_DONE;
+    case FEED_DONE:
+        return UPARSE_FEED_DONE;
+    case FEED_ERROR:
+        return UPARSE_FEED_ERROR;
+    default:
+        return feed_fail(f,"url ends before its host",' ');
+    }
+}
+
+// Leave the host or port on one of its delimiters.
+
+static uparse_feed_status_t feed_after_host(uparse_feed_t *f,char c) {
+    if (HOST_PORT_DELIM == c) {
+        f->state = FEED_PORT;
+    } else if (PATH_DELIM == c) {
+        f->path[f->path_len++] = c;
+        f->state = FEED_PATH;
+    } else {
+        return feed_fail(f,"host or port is followed by",c);
+    }
+    return UPARSE_FEED_MORE;
+}
+
+// Copy the run of ordinary chars of the current component starting at
+// chunk[i] straight into its buffer, keeping the length in a local, and
+// return the index of the first char the run stopped at. Delimiters,
+// invalid chars and a full buffer are left to the state machine.
+
+static size_t feed_run(uparse_feed_t *f,char const *chunk,size_t i,size_t len) {
+    uint8_t const *const classes = f->classes;
+    size_t n = 0;
+    switch (f->state) {
+    case FEED_HOST:
+        n = f->host_len;
+        while ((i < len) && (n < UPARSE_MAX_HOST_LEN) &&
+               char_in_class(classes,chunk[i],UPARSE_CLASS_HOST)) {
+            f->host[n++] = chunk[i++];
+        }
+        f->host_len = n;
+        break;
+    case FEED_PATH:
+        n = f->path_len;
+        while ((i < len) && (n < UPARSE_MAX_PATH_LEN) &&
+               char_in_class(classes,chunk[i],UPARSE_CLASS_PATH)) {
+            f->path[n++] = chunk[i++];
+        }
+        f->path_len = n;
+        break;
+    case FEED_QUERY:
+        n = f->query_len;
+        while ((i < len) && (n < UPARSE_MAX_QUERY_LEN) &&
+               char_in_class(classes,chunk[i],UPARSE_CLASS_QUERY)) {
+            f->query[n++] = chunk[i++];
+        }
+        f->query_len = n;
+        break;
+    case FEED_FRAGMENT:
+        n = f->fragment_len;
+        while ((i < len) && (n < UPARSE_MAX_FRAGMENT_LEN) &&
+               char_in_class(classes,chunk[i],UPARSE_CLASS_FRAGMENT)) {
+            f->fragment[n++] = chunk[i++];
+        }
+        f->fragment_len = n;
+        break;
+    default:
+        break;
+    }
+    return i;
+}
+
+// Feed the next len chars of a url to the parser. *used_out is set to the
+// number of chars consumed. Returns UPARSE_FEED_MORE if the url may go on in
+// the next chunk, UPARSE_FEED_DONE once a space, tab, CR or LF ends it (the
+// terminator is not consumed), or UPARSE_FEED_ERROR as soon as the chars
+// seen cannot start a valid url.
+
+UPARSE_DEF uparse_feed_status_t uparse_feed(uparse_feed_t *f,char const *chunk,size_t len,size_t *used_out) {
+
+    *used_out = 0;
+
+    if (FEED_DONE == f->state) {
+        return UPARSE_FEED_DONE;
+    }
+    if (FEED_ERROR == f->state) {
+        return UPARSE_FEED_ERROR;
+    }
+
+    size_t i = 0;
+    while (i < len) {
+
+        i = feed_run(f,chunk,i,len);
+        if (i == len) {
+            break;
+        }
+
+        char const c = chunk[i];
+
+        if (feed_terminator(c)) {
+            *used_out = i;
+            return feed_end(f);
+        }
+        i++;
+        *used_out = i;
+
+        switch (f->state) {
+
+        case FEED_SCHEME:
+            if (SCHEME_DELIM_PREFIX == c) {
+                if (0 == f->scheme_len) {
+                    return feed_fail(f,"no scheme before",c);
+                }
+                f->state = FEED_SCHEME_SLASH;
+            } else if (!isalpha(c)) {
+                return feed_fail(f,"scheme has invalid char",c);
+            } else if (UPARSE_MAX_SCHEME_LEN == f->scheme_len) {
+                return feed_fail(f,"scheme exceeds max scheme len at",c);
+            } else {
+                f->scheme[f->scheme_len++] = c;
+            }
+            break;
+
+        case FEED_SCHEME_SLASH:
+            if (SCHEME_SLASH != c) {
+                return feed_fail(f,"no scheme slash before",c);
+            }
+            f->state = FEED_SLASHES;
+            break;
+
+        case FEED_SLASHES:
+            if (SCHEME_SLASH == c) {
+                break;
+            }
+            f->state = FEED_HOST_START;
+            /* FALLTHRU */
+        case FEED_HOST_START:
+            if (IPV6_OPEN == c) {
+                f->host[f->host_len++] = c;
+                f->state = FEED_IPV6;
+                break;
+            }
+            f->state = FEED_HOST;
+            /* FALLTHRU */
+        case FEED_HOST:
+            if ((HOST_PORT_DELIM == c) || (PATH_DELIM == c) ||
+                (QUERY_DELIM == c) || (FRAGMENT_DELIM == c)) {
+                if (0 == f->host_len) {
+                    return feed_fail(f,"no host before",c);
+                }
+                if (UPARSE_FEED_ERROR == feed_after_host(f,c)) {
+                    return UPARSE_FEED_ERROR;
+                }
+            } else if (!char_in_class(f->classes,c,UPARSE_CLASS_HOST)) {
+                return feed_fail(f,"host has invalid char",c);
+            } else if (UPARSE_MAX_HOST_LEN == f->host_len) {
+                return feed_fail(f,"host exceeds max host len at",c);
+            } else {
+                f->host[f->host_len++] = c;
+            }
+            break;
+
+        case FEED_IPV6:
+            if (IPV6_CLOSE == c) {
+                uint8_t addr[16];
+                if (!uparse_parse_ipv6(f->host + 1,f->host_len - 1,addr)) {
+                    return feed_fail(f,"host has invalid ipv6 literal ending",c);
+                }
+                f->host[f->host_len++] = c;
+                f->state = FEED_IPV6_END;
+            } else if (!((0 <= hex_value(c)) || (':' == c) || (DOMAIN_DELIM == c))) {
+                return feed_fail(f,"ipv6 literal has invalid char",c);
+            } else if (48 == f->host_len) {
+                return feed_fail(f,"ipv6 literal is too long at",c);
+            } else {
+                f->host[f->host_len++] = c;
+            }
+            break;
+
+        case FEED_IPV6_END:
+            if (UPARSE_FEED_ERROR == feed_after_host(f,c)) {
+                return UPARSE_FEED_ERROR;
+            }
+            break;
+
+        case FEED_PORT:
+            if (PATH_DELIM == c) {
+                if (0 == f->port) {
+                    return feed_fail(f,"empty or zero port before",c);
+                }
+                f->path[f->path_len++] = c;
+                f->state = FEED_PATH;
+            } else if (!isdigit(c)) {
+                return feed_fail(f,"port char is not a digit",c);
+            } else if (UPARSE_MAX_PORT_LEN == f->port_len) {
+                return feed_fail(f,"port str exceeds max port str len at",c);
+            } else {
+                f->port = (f->port * 10) + (unsigned long) (c - '0');
+                f->port_len++;
+                if (65535 <= f->port) {
+                    return feed_fail(f,"port exceeds the maximum port value at",c);
+                }
+            }
+            break;
+
+        case FEED_PATH:
+            if (QUERY_DELIM == c) {
+                f->has_query = true;
+                f->state = FEED_QUERY;
+            } else if (FRAGMENT_DELIM == c) {
+                f->has_fragment = true;
+                f->state = FEED_FRAGMENT;
+            } else if (!char_in_class(f->classes,c,UPARSE_CLASS_PATH)) {
+                return feed_fail(f,"path has invalid char",c);
+            } else if (UPARSE_MAX_PATH_LEN == f->path_len) {
+                return feed_fail(f,"path str exceeds max path str len at",c);
+            } else {
+                f->path[f->path_len++] = c;
+            }
+            break;
+
+        case FEED_QUERY:
+            if (FRAGMENT_DELIM == c) {
+                f->has_fragment = true;
+                f->state = FEED_FRAGMENT;
+            } else if (!char_in_class(f->classes,c,UPARSE_CLASS_QUERY)) {
+                return feed_fail(f,"query has invalid char",c);
+            } else if (UPARSE_MAX_QUERY_LEN == f->query_len) {
+                return feed_fail(f,"query str exceeds max query str len at",c);
+            } else {
+                f->query[f->query_len++] = c;
+            }
+            break;
+
+        case FEED_FRAGMENT:
+            if (!char_in_class(f->classes,c,UPARSE_CLASS_FRAGMENT)) {
+                return feed_fail(f,"fragment has invalid char",c);
+            } else if (UPARSE_MAX_FRAGMENT_LEN == f->fragment_len) {
+                return feed_fail(f,"fragment str exceeds max fragment str len at",c);
+            } else {
+                f->fragment[f->fragment_len++] = c;
+            }
+            break;
+
+        default:
+            return feed_fail(f,"unknown feed state at",c);
+        }
+    }
+
+    *used_out = len;
+    return UPARSE_FEED_MORE;
+}
+
+// There is no more input: the url ends here.
+
+UPARSE_DEF uparse_feed_status_t uparse_feed_finish(uparse_feed_t *f) {
+    return feed_end(f);
+}
+
+// Build a url_t from a completed feed. Returns NULL if the feed is not
+// UPARSE_FEED_DONE. Free the url with free_url_t as usual.
+
+UPARSE_DEF url_t *uparse_feed_url(uparse_feed_t *f,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if (FEED_DONE != f->state) {
+        fprintf(stderr,"feed is not done\n");
+        return NULL;
+    }
+
+    url_t *url = (url_t *) malloc(sizeof(url_t));
+    if (NULL == url) {
+        fprintf(stderr,"cannot allocate url\n");
+        return NULL;
+    }
+    init_url_t(url);
+
+    url->scheme_kind = uparse_scheme_lookup(f->scheme,f->scheme_len);
+    url->default_port = uparse_scheme_default_port(url->scheme_kind);
+    if (UPARSE_SCHEME_UNKNOWN != url->scheme_kind) {
+        url->scheme = SCHEME_NAMES[url->scheme_kind];
+    } else {
+        char *scheme = strndup(f->scheme,f->scheme_len);
+        if (NULL != scheme) {
+            uparse_lowercase(scheme,scheme,f->scheme_len);
+        }
+        url->scheme = scheme;
+    }
+
+    if (IPV6_OPEN == f->host[0]) {
+        url->host_kind = UPARSE_HOST_IPV6;
+        uparse_parse_ipv6(f->host + 1,f->host_len - 2,url->ipv6);
+    } else if (uparse_parse_ipv4(f->host,f->host_len,&url->ipv4)) {
+        url->host_kind = UPARSE_HOST_IPV4;
+    }
+    url->host = strndup(f->host,f->host_len);
+    if (NULL != url->host) {
+        uparse_lowercase(url->host,url->host,f->host_len);
+    }
+    url->port = (unsigned int) f->port;
+
+    // The vacuous path is "/".
+    url->path = (0 == f->path_len) ? strdup("/") : strndup(f->path,f->path_len);
+    if (f->has_query) {
+        url->query = strndup(f->query,f->query_len);
+    }
+    if (f->has_fragment) {
+        url->fragment = strndup(f->fragment,f->fragment_len);
+    }
+
+    if ((NULL == url->scheme) || (NULL == url->host) || (NULL == url->path) ||
+        (f->has_query && (NULL == url->query)) || (f->has_fragment && (NULL == url->fragment))) {
+        fprintf(stderr,"cannot copy fed url components\n");
+        free_url_t(url);
+        return NULL;
+    }
+
+    *err_out = NO_UPARSE_ERROR;
+    return url;
+}
@@ -7,21 +7,175 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+// Define UPARSE_IMPLEMENTATION before including uparse.h to compile the
+// whole parser into that translation unit with static inline functions,
+// so the compiler can inline and specialize it at each call site. Without
+// it, uparse.h only declares the functions in libuparse.
+#ifdef UPARSE_IMPLEMENTATION
+#define UPARSE_DEF static inline
+#else
+#define UPARSE_DEF
+#endif
 
 #define NO_UPARSE_ERROR 0
 #define UPARSE_ERROR    1
 #define OVERFLOW_ERROR  2
 
+// the longest components parse_url accepts
+#define UPARSE_MAX_SCHEME_LEN   16
+#define UPARSE_MAX_HOST_LEN     128
+#define UPARSE_MAX_PORT_LEN     6
+#define UPARSE_MAX_PATH_LEN     1024
+#define UPARSE_MAX_QUERY_LEN    1024
+#define UPARSE_MAX_FRAGMENT_LEN 1024
+
+// url_format_ex flags
+#define UPARSE_FORMAT_ESCAPE 1
+
+// character class policies: which chars each component may contain.
+// UPARSE_POLICY_LEGACY allows only alphanumerics and the delimiters, as uparse
+// always has; UPARSE_POLICY_LENIENT allows what browsers send, including
+// utf-8 and chars RFC 3986 wants escaped; UPARSE_POLICY_STRICT allows
+// exactly the RFC 3986 chars (percent escapes are not checked for hex digits).
+typedef enum uparse_policy_t {
+    UPARSE_POLICY_LEGACY = 0,
+    UPARSE_POLICY_LENIENT,
+    UPARSE_POLICY_STRICT,
+    UPARSE_POLICY_COUNT
+} uparse_policy_t;
+
+// the policy used by parse_url, parse_url_interned, parse_request_target,
+// uparse_feed_init, get_path_segments, the path iterator and uparse_router_new;
+// each has an _ex variant taking a policy instead. build with
+// -DUPARSE_DEFAULT_POLICY=UPARSE_POLICY_LENIENT (say) to change it.
+#ifndef UPARSE_DEFAULT_POLICY
+#define UPARSE_DEFAULT_POLICY UPARSE_POLICY_LEGACY
+#endif
+
+// bits in a uparse_char_classes table entry
+#define UPARSE_CLASS_HOST     0x01
+#define UPARSE_CLASS_PATH     0x02
+#define UPARSE_CLASS_QUERY    0x04
+#define UPARSE_CLASS_FRAGMENT 0x08
+
+// ids handed out by an intern table start at 1, so 0 means "not interned"
+#define NO_INTERN_ID    0
+
+// schemes recognized without allocating. for these the scheme string in
+// url_t is a shared lowercase constant; only UPARSE_SCHEME_UNKNOWN schemes
+// are copied (or interned) from the input, lowercased too. either way the
+// scheme belongs to the url_t and is not modified or freed by callers.
+typedef enum uparse_scheme_t {
+    UPARSE_SCHEME_UNKNOWN = 0,
+    UPARSE_SCHEME_HTTP,
+    UPARSE_SCHEME_HTTPS,
+    UPARSE_SCHEME_WS,
+    UPARSE_SCHEME_WSS,
+    UPARSE_SCHEME_FTP,
+    UPARSE_SCHEME_FTPS,
+    UPARSE_SCHEME_SFTP,
+    UPARSE_SCHEME_SSH,
+    UPARSE_SCHEME_FILE,
+    UPARSE_SCHEME_GIT,
+    UPARSE_SCHEME_TELNET,
+    UPARSE_SCHEME_GOPHER,
+    UPARSE_SCHEME_NNTP,
+    UPARSE_SCHEME_LDAP,
+    UPARSE_SCHEME_LDAPS,
+    UPARSE_SCHEME_RTSP,
+    UPARSE_SCHEME_COUNT
+} uparse_scheme_t;
+
+// what kind of host a url has
+typedef enum uparse_host_kind_t {
+    UPARSE_HOST_NAME = 0,
+    UPARSE_HOST_IPV4,
+    UPARSE_HOST_IPV6
+} uparse_host_kind_t;
+
 // a url is a { scheme, host, port, path, query, fragment }
+// host_kind tells whether the host is a name or an address literal; for
+// UPARSE_HOST_IPV4 the address is also in ipv4, in host byte order, and for
+// UPARSE_HOST_IPV6 (a host like "[::1]") in ipv6, in network byte order.
+// scheme_kind is the recognized scheme and default_port its well known port
+// (0 if it has none or the scheme is unknown).
+// if scheme_id or host_id is not NO_INTERN_ID, the matching string is owned
+// by the intern table it came from and is not freed by free_url_t
 typedef struct url_t {
-    char         *scheme;
-    char         *host;
-    unsigned int port;
-    char         *path;
-    char         *query;
-    char         *fragment;
+    char const         *scheme;
+    char               *host;
+    unsigned int       port;
+    char               *path;
+    char               *query;
+    char               *fragment;
+    unsigned int       scheme_id;
+    unsigned int       host_id;
+    uparse_scheme_t    scheme_kind;
+    unsigned int       default_port;
+    uparse_host_kind_t host_kind;
+    uint32_t           ipv4;
+    uint8_t            ipv6[16];
 } url_t;
 
+// an intern table maps strings to a shared canonical copy and a small id.
+// lookups of strings already in the table never take a lock, so one table
+// can be shared by many parsing threads.
+typedef struct uparse_intern_t uparse_intern_t;
+
+// a run of len chars inside some other string, not NUL terminated
+typedef struct uparse_span_t {
+    char const *ptr;
+    size_t     len;
+} uparse_span_t;
+
+// walks the '/' separated segments of a path without copying them
+typedef struct uparse_path_iter_t {
+    char const    *c;
+    bool          first;
+    uint8_t const *classes;
+} uparse_path_iter_t;
+
+// the forms of an http request-target
+typedef enum uparse_target_form_t {
+    UPARSE_TARGET_ORIGIN = 0,
+    UPARSE_TARGET_ABSOLUTE,
+    UPARSE_TARGET_AUTHORITY,
+    UPARSE_TARGET_ASTERISK
+} uparse_target_form_t;
+
+// what uparse_feed has found so far
+typedef enum uparse_feed_status_t {
+    UPARSE_FEED_MORE = 0,
+    UPARSE_FEED_DONE,
+    UPARSE_FEED_ERROR
+} uparse_feed_status_t;
+
+// the state of an incremental parse. it holds the components read so far,
+// so a url can be fed in as many chunks as it arrives in. unlike parse_url,
+// which returns a url without its query or fragment when either has an
+// invalid char (and reports UPARSE_ERROR), uparse_feed fails on any invalid
+// char, since it cannot know where the url ends until it has read it all.
+typedef struct uparse_feed_t {
+    unsigned int  state;
+    uint8_t const *classes;
+    bool          has_query;
+    bool          has_fragment;
+    unsigned long port;
+    size_t        port_len;
+    size_t        scheme_len;
+    size_t        host_len;
+    size_t        path_len;
+    size_t        query_len;
+    size_t        fragment_len;
+    char          scheme[UPARSE_MAX_SCHEME_LEN];
+    char          host[UPARSE_MAX_HOST_LEN];
+    char          path[UPARSE_MAX_PATH_LEN];
+    char          query[UPARSE_MAX_QUERY_LEN];
+    char          fragment[UPARSE_MAX_FRAGMENT_LEN];
+} uparse_feed_t;
+
 // the "pairs" of a query key/val
 typedef struct query_key_val_t {
     char *key;
@@ -35,18 +189,71 @@ typedef struct query_arg_list_t {
 } query_arg_list_t;
 
 // escape a string
-char *url_escape(char const *const s);
+UPARSE_DEF char *url_escape(char const *const s);
+
+// character class tables, NULL for an unknown policy
+UPARSE_DEF uint8_t const *uparse_char_classes(uparse_policy_t policy);
+
+// known schemes
+UPARSE_DEF uparse_scheme_t uparse_scheme_lookup(char const *s,size_t len);
+UPARSE_DEF char const *uparse_scheme_name(uparse_scheme_t scheme);
+UPARSE_DEF unsigned int uparse_scheme_default_port(uparse_scheme_t scheme);
+
+// address literals
+UPARSE_DEF bool uparse_parse_ipv4(char const *s,size_t len,uint32_t *addr_out);
+UPARSE_DEF bool uparse_parse_ipv6(char const *s,size_t len,uint8_t addr_out[16]);
+
+// intern tables
+UPARSE_DEF uparse_intern_t *uparse_intern_new(size_t capacity);
+UPARSE_DEF void uparse_intern_free(uparse_intern_t *intern);
+UPARSE_DEF char const *uparse_intern(uparse_intern_t *intern,char const *s,size_t len,unsigned int *id_out);
+UPARSE_DEF char const *uparse_intern_lookup_id(uparse_intern_t *intern,unsigned int id);
+UPARSE_DEF size_t uparse_intern_count(uparse_intern_t *intern);
 
 // parse, init and free urls
-url_t *parse_url(char const *const url_string,unsigned int *url_err_out);
-void init_url_t(url_t *url);
-void free_url_t(url_t *url);
-void print_url(url_t *u);
+UPARSE_DEF url_t *parse_url(char const *const url_string,unsigned int *url_err_out);
+UPARSE_DEF url_t *parse_url_interned(char const *const url_string,uparse_intern_t *intern,unsigned int *url_err_out);
+UPARSE_DEF url_t *parse_url_ex(char const *const url_string,uparse_intern_t *intern,uparse_policy_t policy,
+                               unsigned int *url_err_out);
+UPARSE_DEF url_t *parse_request_target(char const *const target,uparse_target_form_t *form_out,
+                                       unsigned int *url_err_out);
+UPARSE_DEF url_t *parse_request_target_ex(char const *const target,uparse_policy_t policy,
+                                          uparse_target_form_t *form_out,unsigned int *url_err_out);
+UPARSE_DEF void init_url_t(url_t *url);
+UPARSE_DEF void free_url_t(url_t *url);
+UPARSE_DEF void print_url(url_t *u);
+
+// write urls back out
+UPARSE_DEF size_t url_format(url_t const *u,char *dst,size_t cap);
+UPARSE_DEF size_t url_format_ex(url_t const *u,char *dst,size_t cap,unsigned int flags);
+
+// resolve relative references
+UPARSE_DEF size_t url_resolve(url_t const *base,char const *ref,char *dst,size_t cap,unsigned int *err_out);
+
+// parse urls that arrive in chunks
+UPARSE_DEF void uparse_feed_init(uparse_feed_t *f);
+UPARSE_DEF void uparse_feed_init_ex(uparse_feed_t *f,uparse_policy_t policy);
+UPARSE_DEF uparse_feed_status_t uparse_feed(uparse_feed_t *f,char const *chunk,size_t len,size_t *used_out);
+UPARSE_DEF uparse_feed_status_t uparse_feed_finish(uparse_feed_t *f);
+UPARSE_DEF url_t *uparse_feed_url(uparse_feed_t *f,unsigned int *err_out);
+
+// split paths into segments
+UPARSE_DEF size_t get_path_segments(char const *path,uparse_span_t *segs,size_t cap,size_t *overflow_out,
+                                    unsigned int *err_out);
+UPARSE_DEF size_t get_path_segments_ex(char const *path,uparse_span_t *segs,size_t cap,size_t *overflow_out,
+                                       uparse_policy_t policy,unsigned int *err_out);
+UPARSE_DEF void uparse_path_iter_init(uparse_path_iter_t *iter,char const *path);
+UPARSE_DEF bool uparse_path_iter_init_ex(uparse_path_iter_t *iter,char const *path,uparse_policy_t policy);
+UPARSE_DEF bool uparse_path_iter_next(uparse_path_iter_t *iter,uparse_span_t *seg_out,unsigned int *err_out);
 
 // expand query lists
-void free_query_key_val_t(query_key_val_t *query_key_val);
-void free_query_key_val_t_list(query_key_val_t **query_key_vals,size_t len);
-void free_arg_list_t(query_arg_list_t *query_arg_list);
-query_arg_list_t *get_query_arg_list(char *const query_str, unsigned int *err_out);
+UPARSE_DEF void free_query_key_val_t(query_key_val_t *query_key_val);
+UPARSE_DEF void free_query_key_val_t_list(query_key_val_t **query_key_vals,size_t len);
+UPARSE_DEF void free_arg_list_t(query_arg_list_t *query_arg_list);
+UPARSE_DEF query_arg_list_t *get_query_arg_list(char *const query_str, unsigned int *err_out);
+
+#ifdef UPARSE_IMPLEMENTATION
+#include "uparse.c"
+#endif
 
 #endif
@@ -0,0 +1,369 @@
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "uparse_cache.h"
+#include "uparse_internal.h"
+
+// -----------------------------------------
+// PARSE CACHE
+
+// Each shard is a chained hash table threaded onto an lru list, guarded by
+// one mutex. Results are refcounted separately from the entries that hold
+// them, so an entry can be evicted while a caller is still using its result.
+
+typedef struct cached_result_t {
+    uparse_cached_t pub;
+    atomic_size_t   refs;
+} cached_result_t;
+
+typedef struct cache_entry_t {
+    struct cache_entry_t *chain;
+    struct cache_entry_t *prev;
+    struct cache_entry_t *next;
+    cached_result_t      *result;
+    uint64_t             hash;
+    size_t               bytes;
+    size_t               len;
+    char                 key[];
+} cache_entry_t;
+
+typedef struct cache_shard_t {
+    pthread_mutex_t lock;
+    cache_entry_t   **buckets;
+    size_t          bucket_count;
+    cache_entry_t   *head;
+    cache_entry_t   *tail;
+    size_t          entries;
+    size_t          bytes;
+    size_t          max_bytes;
+    size_t          hits;
+    size_t          misses;
+    size_t          evictions;
+} cache_shard_t;
+
+struct uparse_cache_t {
+    cache_shard_t *shards;
+    size_t        shard_count;
+};
+
+static size_t const INITIAL_BUCKET_COUNT = 64;
+static size_t const MIN_SHARD_BYTES = 1024;
+
+static size_t str_bytes(char const *s) {
+    return (NULL == s) ? 0 : strlen(s) + 1;
+}
+
+// Approximate heap footprint of an entry and its result, used for the budget.
+static size_t entry_bytes(cache_entry_t const *e) {
+    size_t bytes = sizeof(cache_entry_t) + e->len + 1 + sizeof(cached_result_t);
+    url_t const *u = e->result->pub.url;
+    bytes += sizeof(url_t);
+    if ((UPARSE_SCHEME_UNKNOWN == u->scheme_kind) && (NO_INTERN_ID == u->scheme_id)) {
+        bytes += str_bytes(u->scheme);
+    }
+    if (NO_INTERN_ID == u->host_id) {
+        bytes += str_bytes(u->host);
+    }
+    bytes += str_bytes(u->path) + str_bytes(u->query) + str_bytes(u->fragment);
+    query_arg_list_t const *q = e->result->pub.query_args;
+    if (NULL != q) {
+        bytes += sizeof(query_arg_list_t) + (q->count * sizeof(query_key_val_t *));
+        for (size_t i = 0; i < q->count; i++) {
+            bytes += sizeof(query_key_val_t) +
+                str_bytes(q->query_key_vals[i]->key) + str_bytes(q->query_key_vals[i]->val);
+        }
+    }
+    return bytes;
+}
+
+// Make a cache with shard_count shards sharing max_bytes between them. A
+// shard with less than MIN_SHARD_BYTES could not keep even a few urls and
+// would return every fill without caching it.
+uparse_cache_t *uparse_cache_new(size_t shard_count,size_t max_bytes) {
+
+    if ((0 == shard_count) || (max_bytes / shard_count < MIN_SHARD_BYTES)) {
+        fprintf(stderr,"cache needs at least %zu bytes for each of %zu shards\n",MIN_SHARD_BYTES,shard_count);
+        return NULL;
+    }
+
+    uparse_cache_t *cache = (uparse_cache_t *) malloc(sizeof(uparse_cache_t));
+    if (NULL == cache) {
+        fprintf(stderr,"cannot allocate cache\n");
+        return NULL;
+    }
+    cache->shards = (cache_shard_t *) calloc(shard_count,sizeof(cache_shard_t));
+    if (NULL == cache->shards) {
+        fprintf(stderr,"cannot allocate cache shards\n");
+        free(cache);
+        return NULL;
+    }
+    cache->shard_count = shard_count;
+
+    for (size_t i = 0; i < shard_count; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        shard->buckets = (cache_entry_t **) calloc(INITIAL_BUCKET_COUNT,sizeof(cache_entry_t *));
+        if ((NULL == shard->buckets) || (0 != pthread_mutex_init(&shard->lock,NULL))) {
+            fprintf(stderr,"cannot init cache shard %lu\n",i);
+            free(shard->buckets);
+            cache->shard_count = i;
+            uparse_cache_free(cache);
+            return NULL;
+        }
+        shard->bucket_count = INITIAL_BUCKET_COUNT;
+        shard->max_bytes = max_bytes / shard_count;
+    }
+    return cache;
+}
+
+static void free_result(cached_result_t *result) {
+    if (NULL != result->pub.url) {
+        free_url_t(result->pub.url);
+    }
+    free_arg_list_t(result->pub.query_args);
+    free(result);
+}
+
+// Drop a reference to a result returned by uparse_cache_get.
+void uparse_cached_release(uparse_cached_t const *cached) {
+    if (NULL == cached) {
+        return;
+    }
+    cached_result_t *result = (cached_result_t *) cached;
+    if (1 == atomic_fetch_sub_explicit(&result->refs,1,memory_order_acq_rel)) {
+        free_result(result);
+    }
+}
+
+static void free_entry(cache_entry_t *e) {
+    uparse_cached_release(&e->result->pub);
+    free(e);
+}
+
+// Free the cache. Results still held by callers stay valid until released.
+void uparse_cache_free(uparse_cache_t *cache) {
+    if (NULL == cache) {
+        return;
+    }
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        cache_entry_t *e = shard->head;
+        while (NULL != e) {
+            cache_entry_t *next = e->next;
+            free_entry(e);
+            e = next;
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(cache->shards);
+    free(cache);
+}
+
+static void lru_unlink(cache_shard_t *shard,cache_entry_t *e) {
+    if (NULL != e->prev) {
+        e->prev->next = e->next;
+    } else {
+        shard->head = e->next;
+    }
+    if (NULL != e->next) {
+        e->next->prev = e->prev;
+    } else {
+        shard->tail = e->prev;
+    }
+    e->prev = NULL;
+    e->next = NULL;
+}
+
+static void lru_push_front(cache_shard_t *shard,cache_entry_t *e) {
+    e->prev = NULL;
+    e->next = shard->head;
+    if (NULL != shard->head) {
+        shard->head->prev = e;
+    } else {
+        shard->tail = e;
+    }
+    shard->head = e;
+}
+
+static cache_entry_t *shard_find(cache_shard_t *shard,char const *s,size_t len,uint64_t hash) {
+    cache_entry_t *e = shard->buckets[hash & (shard->bucket_count - 1)];
+    while (NULL != e) {
+        if ((e->hash == hash) && (e->len == len) && (0 == memcmp(e->key,s,len))) {
+            return e;
+        }
+        e = e->chain;
+    }
+    return NULL;
+}
+
+static void shard_remove(cache_shard_t *shard,cache_entry_t *e) {
+    cache_entry_t **link = &shard->buckets[e->hash & (shard->bucket_count - 1)];
+    while (*link != e) {
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+    lru_unlink(shard,e);
+    shard->entries--;
+    shard->bytes -= e->bytes;
+}
+
+// Double the buckets once the chains average more than one entry. Failing to
+// grow is not an error, the chains just get longer.
+static void shard_grow(cache_shard_t *shard) {
+    size_t const bucket_count = 2 * shard->bucket_count;
+    cache_entry_t **buckets = (cache_entry_t **) calloc(bucket_count,sizeof(cache_entry_t *));
+    if (NULL == buckets) {
+        return;
+    }
+    for (cache_entry_t *e = shard->head; NULL != e; e = e->next) {
+        size_t const b = e->hash & (bucket_count - 1);
+        e->chain = buckets[b];
+        buckets[b] = e;
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = bucket_count;
+}
+
+// Parse the url in a new entry. The result starts with one reference, owned
+// by the entry.
+static cache_entry_t *make_entry(char const *s,size_t len,uint64_t hash,unsigned int *err_out) {
+
+    cache_entry_t *e = (cache_entry_t *) calloc(1,sizeof(cache_entry_t) + len + 1);
+    cached_result_t *result = (cached_result_t *) calloc(1,sizeof(cached_result_t));
+    if ((NULL == e) || (NULL == result)) {
+        fprintf(stderr,"cannot allocate cache entry\n");
+        free(e);
+        free(result);
+        *err_out = UPARSE_ERROR;
+        return NULL;
+    }
+    memcpy(e->key,s,len);
+    e->key[len] = '\0';
+    e->len  = len;
+    e->hash = hash;
+
+    result->pub.url = parse_url(e->key,err_out);
+    if ((NULL == result->pub.url) || (NO_UPARSE_ERROR != *err_out)) {
+        *err_out = UPARSE_ERROR;
+        free_result(result);
+        free(e);
+        return NULL;
+    }
+    if (NULL != result->pub.url->query) {
+        unsigned int query_err = NO_UPARSE_ERROR;
+        result->pub.query_args = get_query_arg_list(result->pub.url->query,&query_err);
+    }
+    atomic_init(&result->refs,1);
+    e->result = result;
+    e->bytes = entry_bytes(e);
+    return e;
+}
+
+// Look up the len bytes at url_string, parsing and caching them on a miss.
+// Returns a new reference to the shared result, or NULL if the url does not
+// parse. Release the result with uparse_cached_release.
+uparse_cached_t const *uparse_cache_get(uparse_cache_t *cache,char const *url_string,size_t len,
+                                        unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == cache) || (NULL == url_string)) {
+        return NULL;
+    }
+
+    uint64_t const hash = uparse_fnv1a(url_string,len);
+    cache_shard_t *shard = &cache->shards[(hash >> 32) % cache->shard_count];
+
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t *e = shard_find(shard,url_string,len,hash);
+    if (NULL != e) {
+        shard->hits++;
+        lru_unlink(shard,e);
+        lru_push_front(shard,e);
+        cached_result_t *result = e->result;
+        atomic_fetch_add_explicit(&result->refs,1,memory_order_relaxed);
+        pthread_mutex_unlock(&shard->lock);
+        *err_out = NO_UPARSE_ERROR;
+        return &result->pub;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    // Parse without holding the lock. The miss is counted once it is known
+    // whose parse is returned.
+    cache_entry_t *fresh = make_entry(url_string,len,hash,err_out);
+    if (NULL == fresh) {
+        pthread_mutex_lock(&shard->lock);
+        shard->misses++;
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+
+    // Another thread may have cached the same url while we parsed, and its
+    // entry is returned, so this lookup is a hit after all.
+    e = shard_find(shard,url_string,len,hash);
+    if (NULL != e) {
+        shard->hits++;
+        lru_unlink(shard,e);
+        lru_push_front(shard,e);
+        cached_result_t *result = e->result;
+        atomic_fetch_add_explicit(&result->refs,1,memory_order_relaxed);
+        pthread_mutex_unlock(&shard->lock);
+        free_entry(fresh);
+        *err_out = NO_UPARSE_ERROR;
+        return &result->pub;
+    }
+
+    shard->misses++;
+    cached_result_t *result = fresh->result;
+    atomic_fetch_add_explicit(&result->refs,1,memory_order_relaxed);
+
+    // A result bigger than the whole shard budget is returned but not kept.
+    if (fresh->bytes > shard->max_bytes) {
+        pthread_mutex_unlock(&shard->lock);
+        free_entry(fresh);
+        *err_out = NO_UPARSE_ERROR;
+        return &result->pub;
+    }
+
+    while ((shard->bytes + fresh->bytes) > shard->max_bytes) {
+        cache_entry_t *victim = shard->tail;
+        shard_remove(shard,victim);
+        shard->evictions++;
+        free_entry(victim);
+    }
+
+    if (shard->entries >= shard->bucket_count) {
+        shard_grow(shard);
+    }
+    size_t const b = hash & (shard->bucket_count - 1);
+    fresh->chain = shard->buckets[b];
+    shard->buckets[b] = fresh;
+    lru_push_front(shard,fresh);
+    shard->entries++;
+    shard->bytes += fresh->bytes;
+
+    pthread_mutex_unlock(&shard->lock);
+    *err_out = NO_UPARSE_ERROR;
+    return &result->pub;
+}
+
+// Sum the counters of every shard into *stats_out.
+void uparse_cache_stats(uparse_cache_t *cache,uparse_cache_stats_t *stats_out) {
+    memset(stats_out,0,sizeof(uparse_cache_stats_t));
+    if (NULL == cache) {
+        return;
+    }
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats_out->hits      += shard->hits;
+        stats_out->misses    += shard->misses;
+        stats_out->evictions += shard->evictions;
+        stats_out->entries   += shard->entries;
+        stats_out->bytes     += shard->bytes;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef UPARSE_CACHE_H
+#define UPARSE_CACHE_H
+
+#include "uparse.h"
+
+// a shared, immutable parse result. url and query_args must not be modified
+// or freed, release the result with uparse_cached_release instead.
+// query_args is NULL if the url has no query or the query has no key/vals.
+typedef struct uparse_cached_t {
+    url_t            *url;
+    query_arg_list_t *query_args;
+} uparse_cached_t;
+
+// counters for a cache, summed over all shards. a lookup is a miss only if
+// its own parse is returned; one that finds the url cached by another thread
+// while it parsed is a hit.
+typedef struct uparse_cache_stats_t {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+} uparse_cache_stats_t;
+
+// a cache of parse results keyed by the raw url bytes. it is split into
+// shards, each with its own lock and lru list, and holds at most max_bytes
+// of results in total. max_bytes must give each shard at least 1024 bytes.
+typedef struct uparse_cache_t uparse_cache_t;
+
+uparse_cache_t *uparse_cache_new(size_t shard_count,size_t max_bytes);
+void uparse_cache_free(uparse_cache_t *cache);
+uparse_cached_t const *uparse_cache_get(uparse_cache_t *cache,char const *url_string,size_t len,
+                                        unsigned int *err_out);
+void uparse_cached_release(uparse_cached_t const *cached);
+void uparse_cache_stats(uparse_cache_t *cache,uparse_cache_stats_t *stats_out);
+
+#endif
@@ -0,0 +1,237 @@
+#include <stdint.h>
+#include "uparse_compact.h"
+#include "uparse_internal.h"
+
+// -----------------------------------------
+// COMPACT URLS
+
+// The components are stored back to back, without NULs, in the order
+// below. Component i is the bytes from off[i] up to off[i + 1], so one
+// array of offsets gives both starts and lengths. Whether the url has a
+// query or fragment at all is kept in flags, since either may be empty.
+
+enum {
+    COMPACT_SCHEME = 0,
+    COMPACT_HOST,
+    COMPACT_PATH,
+    COMPACT_QUERY,
+    COMPACT_FRAGMENT,
+    COMPACT_PARTS
+};
+
+#define COMPACT_HAS_QUERY    0x01
+#define COMPACT_HAS_FRAGMENT 0x02
+
+struct uparse_compact_t {
+    uint32_t ipv4;
+    uint16_t port;
+    uint8_t  scheme_kind;
+    uint8_t  host_kind;
+    uint8_t  flags;
+    uint16_t off[COMPACT_PARTS + 1];
+    char     bytes[];
+};
+
+// Lay out the parts in a single new block. Fails with OVERFLOW_ERROR if
+// they do not fit the uint16 offsets, which parse_url never produces.
+
+static uparse_compact_t *compact_new(char const *const parts[COMPACT_PARTS],size_t const lens[COMPACT_PARTS],
+                                     unsigned long port,uparse_scheme_t scheme_kind,uparse_host_kind_t host_kind,
+                                     uint32_t ipv4,uint8_t flags,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if (UINT16_MAX < port) {
+        fprintf(stderr,"port %lu does not fit a compact url\n",port);
+        return NULL;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < COMPACT_PARTS; i++) {
+        total += lens[i];
+    }
+    if (UINT16_MAX < total) {
+        fprintf(stderr,"url of %zu bytes does not fit a compact url\n",total);
+        *err_out = OVERFLOW_ERROR;
+        return NULL;
+    }
+
+    uparse_compact_t *c = (uparse_compact_t *) malloc(sizeof(uparse_compact_t) + total);
+    if (NULL == c) {
+        fprintf(stderr,"cannot allocate compact url\n");
+        return NULL;
+    }
+    c->ipv4        = ipv4;
+    c->port        = (uint16_t) port;
+    c->scheme_kind = (uint8_t) scheme_kind;
+    c->host_kind   = (uint8_t) host_kind;
+    c->flags       = flags;
+
+    size_t at = 0;
+    for (size_t i = 0; i < COMPACT_PARTS; i++) {
+        c->off[i] = (uint16_t) at;
+        if (0 != lens[i]) {
+            memcpy(c->bytes + at,parts[i],lens[i]);
+        }
+        at += lens[i];
+    }
+    c->off[COMPACT_PARTS] = (uint16_t) at;
+
+    *err_out = NO_UPARSE_ERROR;
+    return c;
+}
+
+// Copy url into a single new block.
+
+uparse_compact_t *uparse_compact_from_url(url_t const *url,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == url) || (NULL == url->host) || (NULL == url->path)) {
+        fprintf(stderr,"url is null or has no host or path\n");
+        return NULL;
+    }
+
+    // A known scheme is recovered from scheme_kind.
+    char const *const parts[COMPACT_PARTS] = {
+        (UPARSE_SCHEME_UNKNOWN == url->scheme_kind) ? url->scheme : NULL,
+        url->host,
+        url->path,
+        url->query,
+        url->fragment
+    };
+    size_t lens[COMPACT_PARTS];
+    for (size_t i = 0; i < COMPACT_PARTS; i++) {
+        lens[i] = (NULL == parts[i]) ? 0 : strlen(parts[i]);
+    }
+    uint8_t const flags = ((NULL != url->query) ? COMPACT_HAS_QUERY : 0) |
+                          ((NULL != url->fragment) ? COMPACT_HAS_FRAGMENT : 0);
+    return compact_new(parts,lens,url->port,url->scheme_kind,url->host_kind,url->ipv4,flags,err_out);
+}
+
+// Parse url_string straight into a compact url. The incremental parser
+// keeps the components in its own buffers, so unlike parse_url and
+// uparse_compact_from_url the compact url is the only allocation.
+
+uparse_compact_t *uparse_compact_parse(char const *const url_string,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if (NULL == url_string) {
+        fprintf(stderr,"url string is null\n");
+        return NULL;
+    }
+
+    uparse_feed_t f;
+    uparse_feed_init(&f);
+    size_t const len = strlen(url_string);
+    size_t used = 0;
+    uparse_feed_status_t status = uparse_feed(&f,url_string,len,&used);
+    if (UPARSE_FEED_MORE == status) {
+        status = uparse_feed_finish(&f);
+    }
+    if (UPARSE_FEED_DONE != status) {
+        return NULL;
+    }
+    // The feed stops at a space, which parse_url does not allow at all.
+    if (used != len) {
+        fprintf(stderr,"url has invalid char '%c'\n",url_string[used]);
+        return NULL;
+    }
+
+    // Schemes and hosts are lowercased as parse_url does.
+    uparse_lowercase(f.scheme,f.scheme,f.scheme_len);
+    uparse_lowercase(f.host,f.host,f.host_len);
+    uparse_host_kind_t host_kind = UPARSE_HOST_NAME;
+    uint32_t ipv4 = 0;
+    if ('[' == f.host[0]) {
+        host_kind = UPARSE_HOST_IPV6;
+    } else if (uparse_parse_ipv4(f.host,f.host_len,&ipv4)) {
+        host_kind = UPARSE_HOST_IPV4;
+    }
+
+    uparse_scheme_t const scheme_kind = uparse_scheme_lookup(f.scheme,f.scheme_len);
+    char const *parts[COMPACT_PARTS] = {f.scheme,f.host,f.path,f.query,f.fragment};
+    size_t lens[COMPACT_PARTS] = {
+        (UPARSE_SCHEME_UNKNOWN == scheme_kind) ? f.scheme_len : 0,
+        f.host_len,
+        f.path_len,
+        f.query_len,
+        f.fragment_len
+    };
+    // The vacuous path is "/".
+    if (0 == f.path_len) {
+        parts[COMPACT_PATH] = "/";
+        lens[COMPACT_PATH] = 1;
+    }
+    uint8_t const flags = (f.has_query ? COMPACT_HAS_QUERY : 0) | (f.has_fragment ? COMPACT_HAS_FRAGMENT : 0);
+    return compact_new(parts,lens,f.port,scheme_kind,host_kind,ipv4,flags,err_out);
+}
+
+void uparse_compact_free(uparse_compact_t *c) {
+    free(c);
+}
+
+// The bytes held by c, header included.
+
+size_t uparse_compact_size(uparse_compact_t const *c) {
+    return sizeof(uparse_compact_t) + c->off[COMPACT_PARTS];
+}
+
+static uparse_span_t compact_part(uparse_compact_t const *c,size_t part) {
+    uparse_span_t span;
+    span.ptr = c->bytes + c->off[part];
+    span.len = (size_t) (c->off[part + 1] - c->off[part]);
+    return span;
+}
+
+uparse_span_t uparse_compact_scheme(uparse_compact_t const *c) {
+    if (UPARSE_SCHEME_UNKNOWN != c->scheme_kind) {
+        uparse_span_t span;
+        span.ptr = uparse_scheme_name((uparse_scheme_t) c->scheme_kind);
+        span.len = strlen(span.ptr);
+        return span;
+    }
+    return compact_part(c,COMPACT_SCHEME);
+}
+
+uparse_span_t uparse_compact_host(uparse_compact_t const *c) {
+    return compact_part(c,COMPACT_HOST);
+}
+
+uparse_span_t uparse_compact_path(uparse_compact_t const *c) {
+    return compact_part(c,COMPACT_PATH);
+}
+
+uparse_span_t uparse_compact_query(uparse_compact_t const *c) {
+    uparse_span_t span = compact_part(c,COMPACT_QUERY);
+    if (0 == (c->flags & COMPACT_HAS_QUERY)) {
+        span.ptr = NULL;
+    }
+    return span;
+}
+
+uparse_span_t uparse_compact_fragment(uparse_compact_t const *c) {
+    uparse_span_t span = compact_part(c,COMPACT_FRAGMENT);
+    if (0 == (c->flags & COMPACT_HAS_FRAGMENT)) {
+        span.ptr = NULL;
+    }
+    return span;
+}
+
+unsigned int uparse_compact_port(uparse_compact_t const *c) {
+    return c->port;
+}
+
+uparse_scheme_t uparse_compact_scheme_kind(uparse_compact_t const *c) {
+    return (uparse_scheme_t) c->scheme_kind;
+}
+
+uparse_host_kind_t uparse_compact_host_kind(uparse_compact_t const *c) {
+    return (uparse_host_kind_t) c->host_kind;
+}
+
+// Kept in the header, so an ipv4 host need not be parsed again.
+
+uint32_t uparse_compact_ipv4(uparse_compact_t const *c) {
+    return c->ipv4;
+}
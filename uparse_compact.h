@@ -0,0 +1,33 @@
+#ifndef UPARSE_COMPACT_H
+#define UPARSE_COMPACT_H
+
+#include "uparse.h"
+
+// a url held in a single allocation: a small header of uint16 offsets, the
+// port, the scheme kind, the host kind and any ipv4 address, followed by the
+// component bytes.
+// a typical url fits in one cache line. the strings of a known scheme are
+// not stored, the accessor returns the shared name from uparse_scheme_name.
+// free it with uparse_compact_free.
+typedef struct uparse_compact_t uparse_compact_t;
+
+uparse_compact_t *uparse_compact_from_url(url_t const *url,unsigned int *err_out);
+uparse_compact_t *uparse_compact_parse(char const *const url_string,unsigned int *err_out);
+void uparse_compact_free(uparse_compact_t *c);
+size_t uparse_compact_size(uparse_compact_t const *c);
+
+// the components, as spans into the compact url. a url without a query or
+// fragment gets a span with a NULL ptr, an empty one a zero len.
+uparse_span_t uparse_compact_scheme(uparse_compact_t const *c);
+uparse_span_t uparse_compact_host(uparse_compact_t const *c);
+uparse_span_t uparse_compact_path(uparse_compact_t const *c);
+uparse_span_t uparse_compact_query(uparse_compact_t const *c);
+uparse_span_t uparse_compact_fragment(uparse_compact_t const *c);
+unsigned int uparse_compact_port(uparse_compact_t const *c);
+uparse_scheme_t uparse_compact_scheme_kind(uparse_compact_t const *c);
+uparse_host_kind_t uparse_compact_host_kind(uparse_compact_t const *c);
+// the address of a UPARSE_HOST_IPV4 host in host byte order, as in url_t; 0
+// for other hosts.
+uint32_t uparse_compact_ipv4(uparse_compact_t const *c);
+
+#endif
@@ -0,0 +1,810 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "uparse_dict.h"
+#include "uparse_internal.h"
+
+// -----------------------------------------
+// URL DICTIONARIES
+
+// A url is kept as its host and its tail, which is the rest of it written
+// "scheme:port/path?query#fragment", the port left out when it is 0. The
+// path always starts with '/' and cannot hold '?' or '#', nor the query '#',
+// so a tail splits back into its parts without escaping.
+//
+// The file is, in native byte order,
+//   header        64 bytes, below
+//   hosts         host_count entries of 32 bytes, sorted by name hash
+//   blocks        block_count + 1 file offsets, the last the end of the file
+//   host names    the bytes of every host name, back to back
+//   block data    the tails of each host, sorted and cut into blocks
+// Within a block each tail is a varint count of bytes shared with the tail
+// before it, a varint count of bytes that follow, and those bytes. The first
+// tail of a block shares nothing, so a lookup binary searches blocks by
+// their first tail in place and decodes only the block that may hold a url.
+// Hosts are ordered by a hash of their name, kept in each entry, so the
+// search for a host compares integers and reads only the name it finds.
+
+#define DICT_MAGIC       "uparsedc"
+#define DICT_BYTE_ORDER  0x01020304U
+#define DICT_VERSION     1U
+#define DICT_HEADER_LEN  64
+#define DICT_HOST_LEN    32
+#define DICT_BLOCK_URLS  16
+
+static char const SCHEME_DELIM   = ':';
+static char const PATH_DELIM     = '/';
+static char const QUERY_DELIM    = '?';
+static char const FRAGMENT_DELIM = '#';
+
+typedef struct dict_host_t {
+    uint64_t hash;
+    size_t name_off;
+    size_t name_len;
+    size_t first_block;
+    size_t block_count;
+    size_t url_count;
+} dict_host_t;
+
+struct uparse_dict_t {
+    char const *base;
+    size_t     len;
+    bool       mapped;
+    size_t     host_count;
+    size_t     url_count;
+    size_t     block_count;
+    size_t     hosts_off;
+    size_t     blocks_off;
+};
+
+typedef struct dict_record_t {
+    uint64_t   hash;
+    char const *key;
+    size_t     off;
+    size_t     host_len;
+    size_t     tail_len;
+} dict_record_t;
+
+struct uparse_dict_builder_t {
+    char          *bytes;
+    size_t        bytes_len;
+    size_t        bytes_cap;
+    dict_record_t *records;
+    size_t        record_count;
+    size_t        record_cap;
+};
+
+static void put_u32(char *p,uint32_t v) {
+    memcpy(p,&v,sizeof(v));
+}
+
+static void put_u64(char *p,uint64_t v) {
+    memcpy(p,&v,sizeof(v));
+}
+
+static uint32_t get_u32(char const *p) {
+    uint32_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+static uint64_t get_u64(char const *p) {
+    uint64_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+// Seven bits a byte, low bits first, the high bit set on all but the last.
+
+static size_t put_varint(char *d,size_t v) {
+    size_t n = 0;
+    while (0x80 <= v) {
+        d[n++] = (char) ((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    d[n++] = (char) v;
+    return n;
+}
+
+static bool get_varint(char const *base,size_t *pos,size_t end,size_t *v_out) {
+    size_t v = 0;
+    for (unsigned int shift = 0; (*pos < end) && (shift < 8 * sizeof(size_t)); shift += 7) {
+        unsigned char const c = (unsigned char) base[(*pos)++];
+        v |= (size_t) (c & 0x7f) << shift;
+        if (0 == (c & 0x80)) {
+            *v_out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool append(char tail[UPARSE_DICT_MAX_TAIL],size_t *n,char const *s,size_t len) {
+    if (len > UPARSE_DICT_MAX_TAIL - *n) {
+        return false;
+    }
+    memcpy(tail + *n,s,len);
+    *n += len;
+    return true;
+}
+
+// Write the tail of url into tail, returning its length, or 0 if url has
+// no host or scheme, a tail too long, or a part holding a delimiter that
+// would split it wrongly: a ':' in the scheme, a '?' or '#' in the path,
+// which must start with '/', or a '#' in the query. parse_url makes none.
+
+static size_t tail_of(url_t const *url,char tail[UPARSE_DICT_MAX_TAIL],unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == url) || (NULL == url->scheme) || (NULL == url->host)) {
+        fprintf(stderr,"url is null or has no scheme or host\n");
+        return 0;
+    }
+    char const *const path = (NULL == url->path) ? "/" : url->path;
+    if (('\0' == url->scheme[0]) || (NULL != strchr(url->scheme,SCHEME_DELIM)) || (PATH_DELIM != path[0]) ||
+        (NULL != strchr(path,QUERY_DELIM)) || (NULL != strchr(path,FRAGMENT_DELIM)) ||
+        ((NULL != url->query) && (NULL != strchr(url->query,FRAGMENT_DELIM)))) {
+        fprintf(stderr,"url has an invalid scheme, path or query\n");
+        return 0;
+    }
+
+    // Built by hand rather than with snprintf, which lookups would pay for.
+    char port[16];
+    size_t port_len = 0;
+    for (unsigned int p = url->port; 0 != p; p /= 10) {
+        port[sizeof(port) - 1 - port_len++] = (char) ('0' + (p % 10));
+    }
+    size_t n = 0;
+    bool const ok =
+        append(tail,&n,url->scheme,strlen(url->scheme)) &&
+        append(tail,&n,&SCHEME_DELIM,1) &&
+        append(tail,&n,port + sizeof(port) - port_len,port_len) &&
+        append(tail,&n,path,strlen(path)) &&
+        ((NULL == url->query) || (append(tail,&n,&QUERY_DELIM,1) && append(tail,&n,url->query,strlen(url->query)))) &&
+        ((NULL == url->fragment) ||
+         (append(tail,&n,&FRAGMENT_DELIM,1) && append(tail,&n,url->fragment,strlen(url->fragment))));
+    if (!ok) {
+        fprintf(stderr,"url exceeds max dict tail len %d\n",UPARSE_DICT_MAX_TAIL);
+        *err_out = OVERFLOW_ERROR;
+        return 0;
+    }
+    *err_out = NO_UPARSE_ERROR;
+    return n;
+}
+
+// Split a tail into the spans of url_out, host aside.
+
+static void split_tail(char const *tail,size_t len,uparse_dict_url_t *url_out) {
+    size_t i = 0;
+    while ((i < len) && (SCHEME_DELIM != tail[i])) {
+        i++;
+    }
+    url_out->scheme = (uparse_span_t) {tail,i};
+    if (i < len) {
+        i++;
+    }
+    unsigned int port = 0;
+    while ((i < len) && ('0' <= tail[i]) && (tail[i] <= '9')) {
+        port = (port * 10) + (unsigned int) (tail[i] - '0');
+        i++;
+    }
+    url_out->port = port;
+    size_t const path = i;
+    while ((i < len) && (QUERY_DELIM != tail[i]) && (FRAGMENT_DELIM != tail[i])) {
+        i++;
+    }
+    url_out->path = (uparse_span_t) {tail + path,i - path};
+    url_out->query = (uparse_span_t) {NULL,0};
+    url_out->fragment = (uparse_span_t) {NULL,0};
+    if ((i < len) && (QUERY_DELIM == tail[i])) {
+        size_t const query = ++i;
+        while ((i < len) && (FRAGMENT_DELIM != tail[i])) {
+            i++;
+        }
+        url_out->query = (uparse_span_t) {tail + query,i - query};
+    }
+    if ((i < len) && (FRAGMENT_DELIM == tail[i])) {
+        i++;
+        url_out->fragment = (uparse_span_t) {tail + i,len - i};
+    }
+}
+
+static int bytes_cmp(char const *a,size_t a_len,char const *b,size_t b_len) {
+    size_t const len = (a_len < b_len) ? a_len : b_len;
+    int const cmp = memcmp(a,b,len);
+    if (0 != cmp) {
+        return cmp;
+    }
+    return (a_len == b_len) ? 0 : ((a_len < b_len) ? -1 : 1);
+}
+
+
+// -----------------------------------------
+// BUILDING
+
+uparse_dict_builder_t *uparse_dict_builder_new(void) {
+    uparse_dict_builder_t *b = (uparse_dict_builder_t *) calloc(1,sizeof(uparse_dict_builder_t));
+    if (NULL == b) {
+        fprintf(stderr,"cannot allocate dict builder\n");
+    }
+    return b;
+}
+
+void uparse_dict_builder_free(uparse_dict_builder_t *b) {
+    if (NULL == b) {
+        return;
+    }
+    free(b->bytes);
+    free(b->records);
+    free(b);
+}
+
+bool uparse_dict_builder_add(uparse_dict_builder_t *b,url_t const *url,unsigned int *err_out) {
+
+    char tail[UPARSE_DICT_MAX_TAIL];
+    size_t const tail_len = tail_of(url,tail,err_out);
+    if (0 == tail_len) {
+        return false;
+    }
+    *err_out = UPARSE_ERROR;
+
+    size_t const host_len = strlen(url->host);
+    if ((0 == host_len) || (UPARSE_MAX_HOST_LEN < host_len)) {
+        fprintf(stderr,"url has an empty or long host\n");
+        return false;
+    }
+    if (!uparse_grow((void **) &b->bytes,&b->bytes_cap,b->bytes_len + host_len + tail_len,1) ||
+        !uparse_grow((void **) &b->records,&b->record_cap,b->record_count + 1,sizeof(dict_record_t))) {
+        fprintf(stderr,"cannot allocate dict url\n");
+        return false;
+    }
+    // Lowercased as parse_url gives them, so a url_t built by hand with
+    // "Example.COM" is filed under "example.com".
+    uparse_lowercase(b->bytes + b->bytes_len,url->host,host_len);
+    dict_record_t *const r = &b->records[b->record_count++];
+    r->hash = uparse_fnv1a(b->bytes + b->bytes_len,host_len);
+    r->key = NULL;
+    r->off = b->bytes_len;
+    r->host_len = host_len;
+    r->tail_len = tail_len;
+    memcpy(b->bytes + b->bytes_len + host_len,tail,tail_len);
+    b->bytes_len += host_len + tail_len;
+
+    *err_out = NO_UPARSE_ERROR;
+    return true;
+}
+
+// By host hash, host, then tail.
+static int record_cmp(void const *a,void const *b) {
+    dict_record_t const *x = (dict_record_t const *) a;
+    dict_record_t const *y = (dict_record_t const *) b;
+    if (x->hash != y->hash) {
+        return (x->hash < y->hash) ? -1 : 1;
+    }
+    int const cmp = bytes_cmp(x->key,x->host_len,y->key,y->host_len);
+    if (0 != cmp) {
+        return cmp;
+    }
+    return bytes_cmp(x->key + x->host_len,x->tail_len,y->key + y->host_len,y->tail_len);
+}
+
+static size_t shared_prefix(char const *a,size_t a_len,char const *b,size_t b_len) {
+    size_t const len = (a_len < b_len) ? a_len : b_len;
+    size_t i = 0;
+    while ((i < len) && (a[i] == b[i])) {
+        i++;
+    }
+    return i;
+}
+
+char *uparse_dict_builder_build(uparse_dict_builder_t *b,size_t *len_out,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    for (size_t i = 0; i < b->record_count; i++) {
+        b->records[i].key = b->bytes + b->records[i].off;
+    }
+    if (0 < b->record_count) {
+        qsort((void *) b->records,b->record_count,sizeof(dict_record_t),record_cmp);
+    }
+
+    // Host entries and block offsets are first kept relative to the names
+    // and the block data, which are laid out once their sizes are known.
+    dict_host_t *hosts = NULL;
+    size_t host_count = 0;
+    size_t host_cap = 0;
+    size_t *blocks = NULL;
+    size_t block_count = 0;
+    size_t block_cap = 0;
+    char *names = NULL;
+    size_t names_len = 0;
+    size_t names_cap = 0;
+    char *data = NULL;
+    size_t data_len = 0;
+    size_t data_cap = 0;
+    size_t url_count = 0;
+    bool ok = true;
+
+    dict_record_t const *prev = NULL;
+    size_t in_block = 0;
+    for (size_t i = 0; ok && (i < b->record_count); i++) {
+        dict_record_t const *const r = &b->records[i];
+        if ((NULL != prev) && (0 == record_cmp(prev,r))) {
+            continue;
+        }
+        char const *const tail = r->key + r->host_len;
+        bool const new_host = (NULL == prev) || (0 != bytes_cmp(prev->key,prev->host_len,r->key,r->host_len));
+        if (new_host) {
+            ok = uparse_grow((void **) &hosts,&host_cap,host_count + 1,sizeof(dict_host_t)) &&
+                 uparse_grow((void **) &names,&names_cap,names_len + r->host_len,1);
+            if (!ok) {
+                break;
+            }
+            dict_host_t *const h = &hosts[host_count++];
+            h->hash = r->hash;
+            h->name_off = names_len;
+            h->name_len = r->host_len;
+            h->first_block = block_count;
+            h->block_count = 0;
+            h->url_count = 0;
+            memcpy(names + names_len,r->key,r->host_len);
+            names_len += r->host_len;
+        }
+        dict_host_t *const h = &hosts[host_count - 1];
+        if (new_host || (DICT_BLOCK_URLS == in_block)) {
+            ok = uparse_grow((void **) &blocks,&block_cap,block_count + 1,sizeof(size_t));
+            if (!ok) {
+                break;
+            }
+            blocks[block_count++] = data_len;
+            h->block_count++;
+            in_block = 0;
+        }
+        size_t const shared = (0 == in_block) ? 0 :
+            shared_prefix(prev->key + prev->host_len,prev->tail_len,tail,r->tail_len);
+        ok = uparse_grow((void **) &data,&data_cap,data_len + 20 + r->tail_len - shared,1);
+        if (!ok) {
+            break;
+        }
+        data_len += put_varint(data + data_len,shared);
+        data_len += put_varint(data + data_len,r->tail_len - shared);
+        memcpy(data + data_len,tail + shared,r->tail_len - shared);
+        data_len += r->tail_len - shared;
+        h->url_count++;
+        in_block++;
+        url_count++;
+        prev = r;
+    }
+    if (!ok) {
+        fprintf(stderr,"cannot allocate dict\n");
+    } else if ((UINT32_MAX < block_count) || (UINT32_MAX < url_count)) {
+        fprintf(stderr,"dict exceeds %u blocks or urls\n",UINT32_MAX);
+        *err_out = OVERFLOW_ERROR;
+        ok = false;
+    }
+
+    char *image = NULL;
+    size_t const hosts_off = DICT_HEADER_LEN;
+    size_t const blocks_off = hosts_off + (host_count * DICT_HOST_LEN);
+    size_t const names_off = blocks_off + ((block_count + 1) * sizeof(uint64_t));
+    size_t const data_off = names_off + names_len;
+    size_t const len = data_off + data_len;
+    if (ok) {
+        image = (char *) malloc(len);
+        if (NULL == image) {
+            fprintf(stderr,"cannot allocate dict image of %zu bytes\n",len);
+        }
+    }
+    if (NULL != image) {
+        memset(image,0,DICT_HEADER_LEN);
+        memcpy(image,DICT_MAGIC,8);
+        put_u32(image + 8,DICT_BYTE_ORDER);
+        put_u32(image + 12,DICT_VERSION);
+        put_u64(image + 16,len);
+        put_u64(image + 24,host_count);
+        put_u64(image + 32,url_count);
+        put_u64(image + 40,block_count);
+        put_u64(image + 48,hosts_off);
+        put_u64(image + 56,blocks_off);
+        for (size_t i = 0; i < host_count; i++) {
+            char *const p = image + hosts_off + (i * DICT_HOST_LEN);
+            put_u64(p,hosts[i].hash);
+            put_u64(p + 8,names_off + hosts[i].name_off);
+            put_u32(p + 16,(uint32_t) hosts[i].name_len);
+            put_u32(p + 20,(uint32_t) hosts[i].first_block);
+            put_u32(p + 24,(uint32_t) hosts[i].block_count);
+            put_u32(p + 28,(uint32_t) hosts[i].url_count);
+        }
+        for (size_t i = 0; i < block_count; i++) {
+            put_u64(image + blocks_off + (i * sizeof(uint64_t)),data_off + blocks[i]);
+        }
+        put_u64(image + blocks_off + (block_count * sizeof(uint64_t)),len);
+        if (0 < names_len) {
+            memcpy(image + names_off,names,names_len);
+        }
+        if (0 < data_len) {
+            memcpy(image + data_off,data,data_len);
+        }
+        *len_out = len;
+        *err_out = NO_UPARSE_ERROR;
+    }
+
+    free(hosts);
+    free(blocks);
+    free(names);
+    free(data);
+    return image;
+}
+
+bool uparse_dict_builder_write(uparse_dict_builder_t *b,char const *path,unsigned int *err_out) {
+
+    size_t len = 0;
+    char *image = uparse_dict_builder_build(b,&len,err_out);
+    if (NULL == image) {
+        return false;
+    }
+    *err_out = UPARSE_ERROR;
+
+    FILE *f = fopen(path,"wb");
+    if (NULL == f) {
+        fprintf(stderr,"cannot open %s\n",path);
+        free(image);
+        return false;
+    }
+    bool const write_ok = (len == fwrite(image,1,len,f));
+    bool const close_ok = (0 == fclose(f));
+    free(image);
+    if (!write_ok || !close_ok) {
+        fprintf(stderr,"cannot write %s\n",path);
+        return false;
+    }
+    *err_out = NO_UPARSE_ERROR;
+    return true;
+}
+
+
+// -----------------------------------------
+// READING
+// Only the header is checked when a dictionary is opened. Every offset read
+// after is checked before it is used, so a damaged file makes lookups fail
+// rather than read outside it.
+
+static uparse_dict_t *dict_from(char const *buf,size_t len,bool mapped,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == buf) || (DICT_HEADER_LEN > len) || (0 != memcmp(buf,DICT_MAGIC,8))) {
+        fprintf(stderr,"not a url dict\n");
+        return NULL;
+    }
+    if ((DICT_BYTE_ORDER != get_u32(buf + 8)) || (DICT_VERSION != get_u32(buf + 12))) {
+        fprintf(stderr,"url dict has another byte order or version\n");
+        return NULL;
+    }
+    uint64_t const file_len = get_u64(buf + 16);
+    uint64_t const host_count = get_u64(buf + 24);
+    uint64_t const block_count = get_u64(buf + 40);
+    uint64_t const hosts_off = get_u64(buf + 48);
+    uint64_t const blocks_off = get_u64(buf + 56);
+    if ((len != file_len) ||
+        (hosts_off > len) || (host_count > (len - hosts_off) / DICT_HOST_LEN) ||
+        (blocks_off > len) || (block_count >= (len - blocks_off) / sizeof(uint64_t))) {
+        fprintf(stderr,"url dict is truncated or damaged\n");
+        return NULL;
+    }
+
+    uparse_dict_t *d = (uparse_dict_t *) malloc(sizeof(uparse_dict_t));
+    if (NULL == d) {
+        fprintf(stderr,"cannot allocate dict\n");
+        return NULL;
+    }
+    d->base = buf;
+    d->len = len;
+    d->mapped = mapped;
+    d->host_count = (size_t) host_count;
+    d->url_count = (size_t) get_u64(buf + 32);
+    d->block_count = (size_t) block_count;
+    d->hosts_off = (size_t) hosts_off;
+    d->blocks_off = (size_t) blocks_off;
+
+    *err_out = NO_UPARSE_ERROR;
+    return d;
+}
+
+uparse_dict_t *uparse_dict_open_buffer(char const *buf,size_t len,unsigned int *err_out) {
+    return dict_from(buf,len,false,err_out);
+}
+
+uparse_dict_t *uparse_dict_open(char const *path,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    int const fd = open(path,O_RDONLY);
+    if (0 > fd) {
+        fprintf(stderr,"cannot open %s\n",path);
+        return NULL;
+    }
+    struct stat st;
+    if ((0 != fstat(fd,&st)) || (DICT_HEADER_LEN > st.st_size)) {
+        fprintf(stderr,"%s is not a url dict\n",path);
+        close(fd);
+        return NULL;
+    }
+    size_t const len = (size_t) st.st_size;
+    void *const base = mmap(NULL,len,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (MAP_FAILED == base) {
+        fprintf(stderr,"cannot map %s\n",path);
+        return NULL;
+    }
+    uparse_dict_t *d = dict_from((char const *) base,len,true,err_out);
+    if (NULL == d) {
+        munmap(base,len);
+    }
+    return d;
+}
+
+void uparse_dict_close(uparse_dict_t *d) {
+    if (NULL == d) {
+        return;
+    }
+    if (d->mapped) {
+        munmap((void *) d->base,d->len);
+    }
+    free(d);
+}
+
+size_t uparse_dict_url_count(uparse_dict_t const *d) {
+    return d->url_count;
+}
+
+size_t uparse_dict_host_count(uparse_dict_t const *d) {
+    return d->host_count;
+}
+
+size_t uparse_dict_bytes(uparse_dict_t const *d) {
+    return d->len;
+}
+
+// Read host entry i, false if it points outside the file.
+
+static bool host_at(uparse_dict_t const *d,size_t i,dict_host_t *h) {
+    char const *const p = d->base + d->hosts_off + (i * DICT_HOST_LEN);
+    h->hash = get_u64(p);
+    h->name_off = (size_t) get_u64(p + 8);
+    h->name_len = get_u32(p + 16);
+    h->first_block = get_u32(p + 20);
+    h->block_count = get_u32(p + 24);
+    h->url_count = get_u32(p + 28);
+    return (h->name_off <= d->len) && (h->name_len <= d->len - h->name_off) &&
+           (h->first_block <= d->block_count) && (h->block_count <= d->block_count - h->first_block);
+}
+
+// The bytes of block i, false if they are outside the file.
+
+static bool block_at(uparse_dict_t const *d,size_t i,size_t *start_out,size_t *end_out) {
+    char const *const p = d->base + d->blocks_off + (i * sizeof(uint64_t));
+    uint64_t const start = get_u64(p);
+    uint64_t const end = get_u64(p + sizeof(uint64_t));
+    if ((start > end) || (end > d->len)) {
+        return false;
+    }
+    *start_out = (size_t) start;
+    *end_out = (size_t) end;
+    return true;
+}
+
+static uint64_t host_hash_at(uparse_dict_t const *d,size_t i) {
+    return get_u64(d->base + d->hosts_off + (i * DICT_HOST_LEN));
+}
+
+// Find the first host with the hash of the len chars at name, then step
+// over any others with that hash to the one named name. The hashes are
+// spread evenly, so the first guess is where the hash would be in the
+// table; the search gallops out from it to bracket the hash and binary
+// searches only the bracket, which is a few cache lines at most.
+
+static bool find_host(uparse_dict_t const *d,char const *name,size_t len,size_t *index_out,dict_host_t *h) {
+    uint64_t const hash = uparse_fnv1a(name,len);
+    size_t lo = 0;
+    size_t hi = d->host_count;
+    if ((0 < hi) && (hi <= UINT32_MAX)) {
+        size_t const guess = (size_t) (((hash >> 32) * (uint64_t) hi) >> 32);
+        if (host_hash_at(d,guess) < hash) {
+            lo = guess + 1;
+            for (size_t step = 1; guess + step < d->host_count; step *= 2) {
+                if (host_hash_at(d,guess + step) < hash) {
+                    lo = guess + step + 1;
+                } else {
+                    hi = guess + step;
+                    break;
+                }
+            }
+        } else {
+            hi = guess;
+            for (size_t step = 1; step <= guess; step *= 2) {
+                if (host_hash_at(d,guess - step) < hash) {
+                    lo = guess - step + 1;
+                    break;
+                }
+                hi = guess - step;
+            }
+        }
+    }
+    while (lo < hi) {
+        size_t const mid = lo + ((hi - lo) / 2);
+        if (host_hash_at(d,mid) < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; (lo < d->host_count) && (host_hash_at(d,lo) == hash); lo++) {
+        if (!host_at(d,lo,h)) {
+            return false;
+        }
+        if (0 == bytes_cmp(d->base + h->name_off,h->name_len,name,len)) {
+            *index_out = lo;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decode the tail at *pos over the previous tail in tail.
+
+static bool next_tail(char const *base,size_t *pos,size_t end,char *tail,size_t *tail_len) {
+    size_t shared = 0;
+    size_t suffix = 0;
+    if (!get_varint(base,pos,end,&shared) || !get_varint(base,pos,end,&suffix) ||
+        (shared > *tail_len) || (suffix > UPARSE_DICT_MAX_TAIL - shared) || (suffix > end - *pos)) {
+        fprintf(stderr,"url dict block is damaged\n");
+        return false;
+    }
+    memcpy(tail + shared,base + *pos,suffix);
+    *pos += suffix;
+    *tail_len = shared + suffix;
+    return true;
+}
+
+bool uparse_dict_contains(uparse_dict_t const *d,url_t const *url) {
+
+    unsigned int err = NO_UPARSE_ERROR;
+    char key[UPARSE_DICT_MAX_TAIL];
+    size_t const key_len = tail_of(url,key,&err);
+    if (0 == key_len) {
+        return false;
+    }
+    size_t const host_len = strlen(url->host);
+    if (UPARSE_MAX_HOST_LEN < host_len) {
+        return false;
+    }
+    char host[UPARSE_MAX_HOST_LEN];
+    uparse_lowercase(host,url->host,host_len);
+    size_t index = 0;
+    dict_host_t h;
+    if (!find_host(d,host,host_len,&index,&h)) {
+        return false;
+    }
+
+    // The last block of the host whose first tail is not after key. A
+    // first tail shares nothing, so it is compared where it lies.
+    size_t lo = h.first_block;
+    size_t hi = h.first_block + h.block_count;
+    size_t found = hi;
+    while (lo < hi) {
+        size_t const mid = lo + ((hi - lo) / 2);
+        size_t pos = 0;
+        size_t end = 0;
+        size_t shared = 0;
+        size_t first_len = 0;
+        if (!block_at(d,mid,&pos,&end) || !get_varint(d->base,&pos,end,&shared) ||
+            !get_varint(d->base,&pos,end,&first_len) || (0 != shared) || (first_len > end - pos)) {
+            return false;
+        }
+        int const cmp = bytes_cmp(d->base + pos,first_len,key,key_len);
+        if (0 == cmp) {
+            return true;
+        }
+        if (cmp < 0) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (found == h.first_block + h.block_count) {
+        return false;
+    }
+
+    size_t pos = 0;
+    size_t end = 0;
+    if (!block_at(d,found,&pos,&end)) {
+        return false;
+    }
+    char tail[UPARSE_DICT_MAX_TAIL];
+    size_t tail_len = 0;
+    while (pos < end) {
+        if (!next_tail(d->base,&pos,end,tail,&tail_len)) {
+            return false;
+        }
+        int const cmp = bytes_cmp(tail,tail_len,key,key_len);
+        if (0 <= cmp) {
+            return 0 == cmp;
+        }
+    }
+    return false;
+}
+
+bool uparse_dict_iter_init(uparse_dict_iter_t *it,uparse_dict_t const *d,uparse_span_t host) {
+    it->dict = d;
+    it->host = 0;
+    it->host_end = d->host_count;
+    it->host_name = (uparse_span_t) {NULL,0};
+    it->block = 0;
+    it->block_end = 0;
+    it->pos = 0;
+    it->end = 0;
+    it->tail_len = 0;
+    if (NULL == host.ptr) {
+        return true;
+    }
+    char name[UPARSE_MAX_HOST_LEN];
+    size_t index = 0;
+    dict_host_t h;
+    if (UPARSE_MAX_HOST_LEN < host.len) {
+        it->host_end = 0;
+        return false;
+    }
+    uparse_lowercase(name,host.ptr,host.len);
+    if (!find_host(d,name,host.len,&index,&h)) {
+        it->host_end = 0;
+        return false;
+    }
+    it->host = index;
+    it->host_end = index + 1;
+    return true;
+}
+
+bool uparse_dict_iter_next(uparse_dict_iter_t *it,uparse_dict_url_t *url_out) {
+    uparse_dict_t const *const d = it->dict;
+    for (;;) {
+        if (it->pos < it->end) {
+            if (!next_tail(d->base,&it->pos,it->end,it->tail,&it->tail_len)) {
+                break;
+            }
+            split_tail(it->tail,it->tail_len,url_out);
+            url_out->host = it->host_name;
+            return true;
+        }
+        if (it->block < it->block_end) {
+            if (!block_at(d,it->block,&it->pos,&it->end)) {
+                break;
+            }
+            it->block++;
+            it->tail_len = 0;
+            continue;
+        }
+        if (it->host < it->host_end) {
+            dict_host_t h;
+            if (!host_at(d,it->host,&h)) {
+                break;
+            }
+            it->host_name = (uparse_span_t) {d->base + h.name_off,h.name_len};
+            it->block = h.first_block;
+            it->block_end = h.first_block + h.block_count;
+            it->host++;
+            continue;
+        }
+        return false;
+    }
+
+    // A damaged file ends the walk.
+    it->host = it->host_end;
+    it->block = it->block_end;
+    it->pos = it->end;
+    return false;
+}
@@ -0,0 +1,74 @@
+#ifndef UPARSE_DICT_H
+#define UPARSE_DICT_H
+
+#include "uparse.h"
+
+// the longest url, less its host, a dictionary holds: scheme, port, path,
+// query and fragment with their delimiters
+#define UPARSE_DICT_MAX_TAIL 4096
+
+// a set of urls in one read-only file, built once by uparse_dict_builder_t.
+// urls are grouped by host, and the rest of each url (scheme, port, path,
+// query and fragment) is sorted and front-coded in small blocks, so the
+// many urls of one site share most of their bytes. a file is used in
+// place, mapped or in memory, so opening it does no work beyond checking
+// its header, and any number of threads may read it at once.
+typedef struct uparse_dict_t uparse_dict_t;
+typedef struct uparse_dict_builder_t uparse_dict_builder_t;
+
+uparse_dict_builder_t *uparse_dict_builder_new(void);
+void uparse_dict_builder_free(uparse_dict_builder_t *b);
+bool uparse_dict_builder_add(uparse_dict_builder_t *b,url_t const *url,unsigned int *err_out);
+
+// the dictionary of the urls added so far, without duplicates, as a
+// malloc'd image of *len_out bytes or written to the file at path
+char *uparse_dict_builder_build(uparse_dict_builder_t *b,size_t *len_out,unsigned int *err_out);
+bool uparse_dict_builder_write(uparse_dict_builder_t *b,char const *path,unsigned int *err_out);
+
+// open maps the file at path. open_buffer uses len bytes at buf, which must
+// outlive the dictionary, without copying them.
+uparse_dict_t *uparse_dict_open(char const *path,unsigned int *err_out);
+uparse_dict_t *uparse_dict_open_buffer(char const *buf,size_t len,unsigned int *err_out);
+void uparse_dict_close(uparse_dict_t *d);
+size_t uparse_dict_url_count(uparse_dict_t const *d);
+size_t uparse_dict_host_count(uparse_dict_t const *d);
+size_t uparse_dict_bytes(uparse_dict_t const *d);
+
+// whether the dictionary has url, found by binary searching the hosts and
+// then the blocks of its host. nothing is allocated. hosts are lowercased
+// when added and looked up, so their case does not matter.
+bool uparse_dict_contains(uparse_dict_t const *d,url_t const *url);
+
+// a url read from a dictionary. host points into the dictionary, the other
+// spans into the iterator they came from, and stay valid until it is
+// advanced. query and fragment have a NULL ptr if the url has none.
+typedef struct uparse_dict_url_t {
+    uparse_span_t scheme;
+    uparse_span_t host;
+    unsigned int  port;
+    uparse_span_t path;
+    uparse_span_t query;
+    uparse_span_t fragment;
+} uparse_dict_url_t;
+
+// walks the urls of a dictionary, decoding one url at a time. the urls of
+// a host come together and sorted, the hosts in no useful order.
+typedef struct uparse_dict_iter_t {
+    uparse_dict_t const *dict;
+    size_t              host;
+    size_t              host_end;
+    uparse_span_t       host_name;
+    size_t              block;
+    size_t              block_end;
+    size_t              pos;
+    size_t              end;
+    size_t              tail_len;
+    char                tail[UPARSE_DICT_MAX_TAIL];
+} uparse_dict_iter_t;
+
+// iterate over every url, or over those of one host if host.ptr is not
+// NULL. false if there is no such host.
+bool uparse_dict_iter_init(uparse_dict_iter_t *it,uparse_dict_t const *d,uparse_span_t host);
+bool uparse_dict_iter_next(uparse_dict_iter_t *it,uparse_dict_url_t *url_out);
+
+#endif
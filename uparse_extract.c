@@ -0,0 +1,257 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "uparse_extract.h"
+
+// -----------------------------------------
+// URL EXTRACTION
+// Urls are found by their "://", which is rare in ordinary text, so the
+// scan over the text only looks for that and the url is then grown from it
+// with the char classes of the policy, backwards over the scheme and
+// forwards over host, port, path, query and fragment.
+
+static char const SCHEME_DELIM    = ':';
+static char const SCHEME_SLASH    = '/';
+static char const HOST_PORT_DELIM = ':';
+static char const PATH_DELIM      = '/';
+static char const QUERY_DELIM     = '?';
+static char const FRAGMENT_DELIM  = '#';
+static char const IPV6_OPEN       = '[';
+static char const IPV6_CLOSE      = ']';
+
+// The longest ipv6 literal, "ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255",
+// is 45 chars, so its ']' is at most this far past the '['.
+static size_t const IPV6_MAX_CLOSE = 46;
+
+// The offset of the first "://" at or after from, or len if there is none.
+// With SSE2 sixteen positions are checked at once: three unaligned loads,
+// one byte apart, are compared against ':', '/' and '/' and the results
+// and-ed, leaving a bit for each position that starts a "://".
+
+static size_t find_scheme_delim(char const *buf,size_t from,size_t len) {
+    size_t i = from;
+#ifdef __SSE2__
+    __m128i const colon = _mm_set1_epi8(SCHEME_DELIM);
+    __m128i const slash = _mm_set1_epi8(SCHEME_SLASH);
+    while (i + 18 <= len) {
+        __m128i const a = _mm_loadu_si128((__m128i const *) (buf + i));
+        __m128i const b = _mm_loadu_si128((__m128i const *) (buf + i + 1));
+        __m128i const c = _mm_loadu_si128((__m128i const *) (buf + i + 2));
+        __m128i const hit = _mm_and_si128(_mm_cmpeq_epi8(a,colon),
+                                          _mm_and_si128(_mm_cmpeq_epi8(b,slash),_mm_cmpeq_epi8(c,slash)));
+        unsigned int const mask = (unsigned int) _mm_movemask_epi8(hit);
+        if (0 != mask) {
+            return i + (size_t) __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#endif
+    // memchr is itself vectorized by most libcs, and ':' is rare enough
+    // that checking the two bytes after each one costs little.
+    while (i + 3 <= len) {
+        char const *const c = memchr(buf + i,SCHEME_DELIM,len - i - 2);
+        if (NULL == c) {
+            return len;
+        }
+        if ((SCHEME_SLASH == c[1]) && (SCHEME_SLASH == c[2])) {
+            return (size_t) (c - buf);
+        }
+        i = (size_t) (c - buf) + 1;
+    }
+    return len;
+}
+
+// Chars that often follow a url in prose without being part of it.
+
+static bool trailing_punct(char c) {
+    return ('.' == c) || (',' == c) || (';' == c) || (':' == c) || ('!' == c) || ('?' == c) ||
+           ('\'' == c) || ('*' == c);
+}
+
+// Advance i over chars of class cls, returning the new offset.
+
+static size_t scan_class(uparse_extract_t const *x,size_t i,uint8_t cls) {
+    while ((i < x->len) && (0 != (x->classes[(unsigned char) x->buf[i]] & cls))) {
+        i++;
+    }
+    return i;
+}
+
+// Try to grow a url around the "://" at delim. On success *found_out is
+// set, with its spans relative to x->buf, and true returned.
+
+static bool extract_at(uparse_extract_t const *x,size_t delim,uparse_found_t *found_out) {
+
+    char const *const buf = x->buf;
+    size_t const len = x->len;
+
+    // The scheme is the run of alpha chars before the ':'. A longer run
+    // than any scheme ("xhttp://") is not taken to be a url.
+    size_t start = delim;
+    while ((start > x->at) && (delim - start < UPARSE_MAX_SCHEME_LEN) && isalpha((unsigned char) buf[start - 1])) {
+        start--;
+    }
+    if ((start == delim) || ((start > x->at) && isalpha((unsigned char) buf[start - 1]))) {
+        return false;
+    }
+
+    // parse_url takes any number of slashes after the ':'.
+    size_t i = delim + 1;
+    while ((i < len) && (SCHEME_SLASH == buf[i])) {
+        i++;
+    }
+
+    size_t const host_start = i;
+    if ((i < len) && (IPV6_OPEN == buf[i])) {
+        // Only look as far as the longest literal could reach, so text
+        // full of '[' without a ']' is not scanned to its end each time.
+        size_t const window = (len - i < IPV6_MAX_CLOSE + 1) ? len - i : IPV6_MAX_CLOSE + 1;
+        char const *const close = memchr(buf + i,IPV6_CLOSE,window);
+        uint8_t addr[16];
+        if ((NULL == close) || !uparse_parse_ipv6(buf + i + 1,(size_t) (close - buf) - i - 1,addr)) {
+            return false;
+        }
+        i = (size_t) (close - buf) + 1;
+    } else {
+        i = scan_class(x,i,UPARSE_CLASS_HOST);
+    }
+    size_t host_end = i;
+
+    // A '.' ends a sentence more often than it ends a host.
+    if (IPV6_OPEN != buf[host_start]) {
+        while ((host_end > host_start) && ('.' == buf[host_end - 1])) {
+            host_end--;
+        }
+        i = host_end;
+    }
+    if ((host_end == host_start) || (UPARSE_MAX_HOST_LEN < host_end - host_start)) {
+        return false;
+    }
+
+    // A ':' not followed by a valid port is left out of the url.
+    size_t port_start = i;
+    size_t port_end = i;
+    unsigned int port_value = 0;
+    if ((i < len) && (HOST_PORT_DELIM == buf[i])) {
+        size_t j = i + 1;
+        unsigned long v = 0;
+        while ((j < len) && isdigit((unsigned char) buf[j]) && (j - i <= UPARSE_MAX_PORT_LEN)) {
+            v = (v * 10) + (unsigned long) (buf[j] - '0');
+            j++;
+        }
+        if ((j > i + 1) && (0 < v) && (v < 65535) && ((j == len) || !isdigit((unsigned char) buf[j]))) {
+            port_start = i + 1;
+            port_end = j;
+            port_value = (unsigned int) v;
+            i = j;
+        }
+    }
+
+    // As in parse_url, a query or fragment is only taken after a path.
+    size_t path_start = i;
+    size_t path_end = i;
+    size_t query_start = i;
+    size_t query_end = i;
+    size_t fragment_start = i;
+    size_t fragment_end = i;
+    bool has_query = false;
+    bool has_fragment = false;
+    if ((i < len) && (PATH_DELIM == buf[i])) {
+        path_end = scan_class(x,i + 1,UPARSE_CLASS_PATH);
+        i = path_end;
+        if ((i < len) && (QUERY_DELIM == buf[i])) {
+            has_query = true;
+            query_start = i + 1;
+            query_end = scan_class(x,query_start,UPARSE_CLASS_QUERY);
+            i = query_end;
+        }
+        if ((i < len) && (FRAGMENT_DELIM == buf[i])) {
+            has_fragment = true;
+            fragment_start = i + 1;
+            fragment_end = scan_class(x,fragment_start,UPARSE_CLASS_FRAGMENT);
+            i = fragment_end;
+        }
+    }
+
+    // Drop trailing punctuation from a url with a path, and a ')' unless the
+    // url has a '(' to pair it, as in "(see http://example.com/a)".
+    size_t end = i;
+    if (end > path_start) {
+        bool const has_open = NULL != memchr(buf + path_start,'(',end - path_start);
+        while (end > path_start + 1) {
+            char const c = buf[end - 1];
+            if (trailing_punct(c) || ((')' == c) && !has_open)) {
+                end--;
+            } else {
+                break;
+            }
+        }
+        if (path_end > end) {
+            path_end = end;
+        }
+        if (has_query && (query_start > end)) {
+            has_query = false;
+        } else if (query_end > end) {
+            query_end = end;
+        }
+        if (has_fragment && (fragment_start > end)) {
+            has_fragment = false;
+        } else if (fragment_end > end) {
+            fragment_end = end;
+        }
+    }
+
+    found_out->url = (uparse_span_t) {buf + start,end - start};
+    found_out->scheme = (uparse_span_t) {buf + start,delim - start};
+    found_out->host = (uparse_span_t) {buf + host_start,host_end - host_start};
+    found_out->port = (uparse_span_t) {buf + port_start,port_end - port_start};
+    found_out->path = (uparse_span_t) {buf + path_start,path_end - path_start};
+    found_out->query = has_query ? (uparse_span_t) {buf + query_start,query_end - query_start} :
+                                   (uparse_span_t) {NULL,0};
+    found_out->fragment = has_fragment ? (uparse_span_t) {buf + fragment_start,fragment_end - fragment_start} :
+                                         (uparse_span_t) {NULL,0};
+    found_out->scheme_kind = uparse_scheme_lookup(buf + start,delim - start);
+    found_out->port_value = port_value;
+    return true;
+}
+
+bool uparse_extract_init(uparse_extract_t *x,char const *buf,size_t len,uparse_policy_t policy) {
+
+    uint8_t const *const classes = uparse_char_classes(policy);
+    if (NULL == classes) {
+        fprintf(stderr,"unknown policy %u\n",(unsigned int) policy);
+        return false;
+    }
+    x->buf = buf;
+    x->len = (NULL == buf) ? 0 : len;
+    x->at = 0;
+    memcpy(x->classes,classes,sizeof(x->classes));
+
+    // These delimit urls in html, mail and markdown, whatever the policy.
+    static char const delims[] = {'"','\'','<','>','`'};
+    for (size_t k = 0; k < sizeof(delims); k++) {
+        x->classes[(unsigned char) delims[k]] = 0;
+    }
+    return true;
+}
+
+bool uparse_extract_next(uparse_extract_t *x,uparse_found_t *found_out) {
+    while (x->at < x->len) {
+        size_t const delim = find_scheme_delim(x->buf,x->at,x->len);
+        if (delim == x->len) {
+            x->at = x->len;
+            return false;
+        }
+        if (extract_at(x,delim,found_out)) {
+            x->at = (size_t) (found_out->url.ptr - x->buf) + found_out->url.len;
+            return true;
+        }
+        x->at = delim + 1;
+    }
+    return false;
+}
@@ -0,0 +1,39 @@
+#ifndef UPARSE_EXTRACT_H
+#define UPARSE_EXTRACT_H
+
+#include "uparse.h"
+
+// a url found in a text buffer. every span points into the buffer. port
+// has the digits of the port (len 0 if there is none) and port_value their
+// value; path has len 0 if the url has no path. a url without a query or
+// fragment gets a span with a NULL ptr there.
+typedef struct uparse_found_t {
+    uparse_span_t   url;
+    uparse_span_t   scheme;
+    uparse_span_t   host;
+    uparse_span_t   port;
+    uparse_span_t   path;
+    uparse_span_t   query;
+    uparse_span_t   fragment;
+    uparse_scheme_t scheme_kind;
+    unsigned int    port_value;
+} uparse_found_t;
+
+// walks a buffer for urls. the host, path, query and fragment chars are
+// those of a uparse_policy_t, except that quotes, '<', '>' and '`' always end
+// a url, as they delimit urls in html and mail. trailing punctuation such
+// as the '.' ending a sentence is left out of a url.
+typedef struct uparse_extract_t {
+    char const *buf;
+    size_t     len;
+    size_t     at;
+    uint8_t    classes[256];
+} uparse_extract_t;
+
+bool uparse_extract_init(uparse_extract_t *x,char const *buf,size_t len,uparse_policy_t policy);
+
+// find the next url, returning false when there are no more. nothing is
+// copied or allocated.
+bool uparse_extract_next(uparse_extract_t *x,uparse_found_t *found_out);
+
+#endif
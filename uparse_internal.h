@@ -0,0 +1,175 @@
+#ifndef UPARSE_INTERNAL_H
+#define UPARSE_INTERNAL_H
+
+#include "uparse.h"
+
+// helpers shared by the uparse sources, not part of the api. they are
+// static inline so each source, uparse.c built header-only included, gets
+// its own copy and nothing more is exported from libuparse.
+
+#define UPARSE_FNV_OFFSET 14695981039346656037ULL
+#define UPARSE_FNV_PRIME  1099511628211ULL
+
+// one byte of an FNV-1a hash. it is small and fast on the short keys
+// hashed here (hosts, urls), and being one function, a hash written to a
+// url dictionary file is the same wherever it is computed.
+static inline uint64_t uparse_fnv1a_step(uint64_t h,char c) {
+    return (h ^ (unsigned char) c) * UPARSE_FNV_PRIME;
+}
+
+static inline uint64_t uparse_fnv1a(char const *s,size_t len) {
+    uint64_t h = UPARSE_FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        h = uparse_fnv1a_step(h,s[i]);
+    }
+    return h;
+}
+
+// c with A-Z lowercased. unlike tolower it ignores the locale and leaves
+// bytes over 0x7f, such as those of a utf-8 host, alone.
+static inline char uparse_lower(char c) {
+    return (('A' <= c) && (c <= 'Z')) ? (char) (c - 'A' + 'a') : c;
+}
+
+// copy len chars from src to dst lowercased. dst may be src. hosts are kept
+// lowercased everywhere, so equal hosts compare and hash equal as bytes.
+static inline void uparse_lowercase(char *dst,char const *src,size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = uparse_lower(src[i]);
+    }
+}
+
+// make *array, which has room for *cap elements of size bytes, hold at
+// least need of them, doubling its capacity from 16. false if realloc fails,
+// with *array left as it was.
+static inline bool uparse_grow(void **array,size_t *cap,size_t need,size_t size) {
+    if (need <= *cap) {
+        return true;
+    }
+    size_t new_cap = (0 == *cap) ? 16 : *cap;
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+    void *p = realloc(*array,new_cap * size);
+    if (NULL == p) {
+        return false;
+    }
+    *array = p;
+    *cap = new_cap;
+    return true;
+}
+
+// append n elements to *array, which holds *count of them, and set
+// *first_out to the index of the first. growing may move the array, so
+// callers hold indices into it rather than pointers.
+static inline bool uparse_reserve(void **array,size_t *cap,size_t *count,size_t n,size_t size,size_t *first_out) {
+    if (!uparse_grow(array,cap,*count + n,size)) {
+        return false;
+    }
+    *first_out = *count;
+    *count += n;
+    return true;
+}
+
+// order two labels (or path segments) by length, then bytes. the compiled
+// tries of the router, the public suffix list and the matcher keep the
+// children of each node sorted this way and binary search them. any total
+// order would do; this one settles most comparisons on the length alone.
+static inline int uparse_label_cmp(char const *a,size_t a_len,char const *b,size_t b_len) {
+    if (a_len != b_len) {
+        return (a_len < b_len) ? -1 : 1;
+    }
+    return memcmp(a,b,a_len);
+}
+
+// a node of the plain trie the router and the public suffix list build
+// before compiling it into flat arrays. each node holds one label, its
+// children are a list. param and the route ids are the router's, flags the
+// public suffix list's.
+typedef struct uparse_build_node_t {
+    char                       *label;
+    size_t                     len;
+    struct uparse_build_node_t *children;
+    struct uparse_build_node_t *sibling;
+    struct uparse_build_node_t *param;
+    size_t                     child_count;
+    unsigned int               flags;
+    unsigned int               route_id;
+    unsigned int               wildcard_route_id;
+} uparse_build_node_t;
+
+// a node labelled with a copy of the len chars at label, or unlabelled if
+// label is NULL. NULL if it cannot be allocated.
+static inline uparse_build_node_t *uparse_build_node_new(char const *label,size_t len) {
+    uparse_build_node_t *b = (uparse_build_node_t *) calloc(1,sizeof(uparse_build_node_t));
+    if (NULL == b) {
+        return NULL;
+    }
+    if (NULL != label) {
+        b->label = strndup(label,len);
+        if (NULL == b->label) {
+            free(b);
+            return NULL;
+        }
+        b->len = len;
+    }
+    return b;
+}
+
+static inline void uparse_build_node_free(uparse_build_node_t *b) {
+    if (NULL == b) {
+        return;
+    }
+    uparse_build_node_t *c = b->children;
+    while (NULL != c) {
+        uparse_build_node_t *next = c->sibling;
+        uparse_build_node_free(c);
+        c = next;
+    }
+    uparse_build_node_free(b->param);
+    free(b->label);
+    free(b);
+}
+
+// the child of node labelled with the len chars at label, added if there is
+// none yet. NULL if it cannot be allocated.
+static inline uparse_build_node_t *uparse_build_node_child(uparse_build_node_t *node,char const *label,size_t len) {
+    uparse_build_node_t *child = node->children;
+    while ((NULL != child) && !((child->len == len) && (0 == memcmp(child->label,label,len)))) {
+        child = child->sibling;
+    }
+    if (NULL == child) {
+        child = uparse_build_node_new(label,len);
+        if (NULL == child) {
+            return NULL;
+        }
+        child->sibling = node->children;
+        node->children = child;
+        node->child_count++;
+    }
+    return child;
+}
+
+static inline int uparse_build_node_cmp(void const *a,void const *b) {
+    uparse_build_node_t const *x = *(uparse_build_node_t const *const *) a;
+    uparse_build_node_t const *y = *(uparse_build_node_t const *const *) b;
+    return uparse_label_cmp(x->label,x->len,y->label,y->len);
+}
+
+// the children of b, which must have some, as a malloc'd array sorted by
+// uparse_label_cmp. NULL if it cannot be allocated.
+static inline uparse_build_node_t const **uparse_build_node_sorted(uparse_build_node_t const *b) {
+    uparse_build_node_t const **children =
+        (uparse_build_node_t const **) malloc(b->child_count * sizeof(uparse_build_node_t *));
+    if (NULL == children) {
+        return NULL;
+    }
+    size_t k = 0;
+    for (uparse_build_node_t const *c = b->children; NULL != c; c = c->sibling) {
+        children[k++] = c;
+    }
+    qsort((void *) children,b->child_count,sizeof(uparse_build_node_t *),uparse_build_node_cmp);
+    return children;
+}
+
+#endif
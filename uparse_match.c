@@ -0,0 +1,711 @@
+#include <stdint.h>
+#include "uparse_match.h"
+#include "uparse_internal.h"
+
+// -----------------------------------------
+// HOST AND PATH RULES
+
+// Rules are kept as added until compile sorts them by host, rightmost label
+// first, and lays out the host suffix trie straight from the sorted runs:
+// one array of nodes, the children of each contiguous and sorted so a
+// lookup binary searches each level. There is no pointer trie to build, as
+// a million rules under "com" would make that quadratic.
+//
+// A host node holds the rules on that host and on the hosts below it. Rules
+// with a path become a radix tree of path prefixes per node, compiled the
+// same way into path nodes and the edges between them.
+//
+// The bloom filter holds a hash of the host of every node: every suffix of
+// every rule host at a label boundary ("www.example.com", "example.com",
+// "com"). A lookup builds the same hashes as it walks from the right, and
+// before binary searching a node with many children asks the filter
+// whether the child it wants can exist, so a host that matches nothing
+// usually stops at one probe instead of a search over a wide level. Each
+// key sets its bits in a single 64 byte block, so a probe touches one cache
+// line.
+
+static char const LABEL_DELIM = '.';
+static char const PATH_DELIM  = '/';
+
+static uint32_t const NO_NODE = UINT32_MAX;
+
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_K           6
+
+// Nodes with fewer children are searched without asking the filter.
+#define BLOOM_MIN_CHILDREN 64
+
+typedef struct match_rule_t {
+    char         *key;       // the host labels reversed: "com.example.www"
+    char         *path;
+    size_t       key_len;
+    size_t       path_len;
+    size_t       labels;
+    size_t       seq;
+    unsigned int id;
+    bool         wildcard;
+} match_rule_t;
+
+typedef struct host_node_t {
+    uint32_t     label_off;
+    uint32_t     first_child;
+    uint32_t     child_count;
+    uint32_t     exact_paths;
+    uint32_t     sub_paths;
+    unsigned int exact_id;
+    unsigned int sub_id;
+    uint8_t      label_len;
+} host_node_t;
+
+typedef struct path_node_t {
+    uint32_t     first_edge;
+    uint32_t     edge_count;
+    unsigned int id;
+} path_node_t;
+
+typedef struct path_edge_t {
+    uint32_t label_off;
+    uint32_t label_len;
+    uint32_t child;
+} path_edge_t;
+
+struct uparse_matcher_t {
+    match_rule_t *rules;
+    size_t       rule_count;
+    size_t       rule_cap;
+    host_node_t  *hosts;
+    size_t       host_count;
+    size_t       host_cap;
+    char         *host_labels;
+    size_t       host_labels_len;
+    size_t       host_labels_cap;
+    path_node_t  *paths;
+    size_t       path_count;
+    size_t       path_cap;
+    path_edge_t  *edges;
+    size_t       edge_count;
+    size_t       edge_cap;
+    char         *path_labels;
+    size_t       path_labels_len;
+    size_t       path_labels_cap;
+    uint64_t     *bloom;
+    size_t       bloom_blocks;
+    bool         compiled;
+};
+
+uparse_matcher_t *uparse_matcher_new(void) {
+    uparse_matcher_t *m = (uparse_matcher_t *) calloc(1,sizeof(uparse_matcher_t));
+    if (NULL == m) {
+        fprintf(stderr,"cannot allocate matcher\n");
+    }
+    return m;
+}
+
+static void free_rules(uparse_matcher_t *m) {
+    for (size_t i = 0; i < m->rule_count; i++) {
+        free(m->rules[i].key);
+    }
+    free(m->rules);
+    m->rules = NULL;
+    m->rule_count = 0;
+    m->rule_cap = 0;
+}
+
+void uparse_matcher_free(uparse_matcher_t *m) {
+    if (NULL == m) {
+        return;
+    }
+    free_rules(m);
+    free(m->hosts);
+    free(m->host_labels);
+    free(m->paths);
+    free(m->edges);
+    free(m->path_labels);
+    free(m->bloom);
+    free(m);
+}
+
+bool uparse_matcher_add(uparse_matcher_t *m,char const *rule,unsigned int rule_id,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == m) || (NULL == rule) || (NO_MATCH_ID == rule_id)) {
+        fprintf(stderr,"matcher, rule and rule_id must be set\n");
+        return false;
+    }
+    if (m->compiled) {
+        fprintf(stderr,"cannot add %s to a compiled matcher\n",rule);
+        return false;
+    }
+
+    char const *host = rule;
+    bool const wildcard = ('*' == host[0]) && (LABEL_DELIM == host[1]);
+    if (wildcard) {
+        host += 2;
+    }
+    char const *path = strchr(host,PATH_DELIM);
+    if (NULL == path) {
+        path = host + strlen(host);
+    }
+    size_t const host_len = (size_t) (path - host);
+    size_t const path_len = strlen(path);
+    if ((0 == host_len) || (UPARSE_MAX_HOST_LEN < host_len) || (UPARSE_MAX_PATH_LEN < path_len)) {
+        fprintf(stderr,"rule %s has an empty or long host or path\n",rule);
+        return false;
+    }
+
+    // Hosts may have the chars browsers allow.
+    uint8_t const *const classes = uparse_char_classes(UPARSE_POLICY_LENIENT);
+    for (size_t i = 0; i < host_len; i++) {
+        if (0 == (classes[(unsigned char) host[i]] & UPARSE_CLASS_HOST)) {
+            fprintf(stderr,"rule %s has invalid host char '%c'\n",rule,host[i]);
+            return false;
+        }
+    }
+
+    if (!uparse_grow((void **) &m->rules,&m->rule_cap,m->rule_count + 1,sizeof(match_rule_t))) {
+        fprintf(stderr,"cannot allocate rule\n");
+        return false;
+    }
+
+    // The key and path share one block.
+    char *key = (char *) malloc(host_len + path_len + 2);
+    if (NULL == key) {
+        fprintf(stderr,"cannot allocate rule\n");
+        return false;
+    }
+
+    // Write the labels in reverse order.
+    size_t labels = 0;
+    size_t k = 0;
+    char const *end = host + host_len;
+    for (;;) {
+        char const *start = end;
+        while ((start > host) && (LABEL_DELIM != start[-1])) {
+            start--;
+        }
+        size_t const len = (size_t) (end - start);
+        if ((0 == len) || (UINT8_MAX < len)) {
+            fprintf(stderr,"rule %s has an empty or long label\n",rule);
+            free(key);
+            return false;
+        }
+        if (0 != labels) {
+            key[k++] = LABEL_DELIM;
+        }
+        uparse_lowercase(key + k,start,len);
+        k += len;
+        labels++;
+        if (start == host) {
+            break;
+        }
+        end = start - 1;
+    }
+    key[k] = '\0';
+    memcpy(key + host_len + 1,path,path_len + 1);
+
+    match_rule_t *r = &m->rules[m->rule_count];
+    r->key      = key;
+    r->key_len  = host_len;
+    r->path     = key + host_len + 1;
+    r->path_len = path_len;
+    r->labels   = labels;
+    r->seq      = m->rule_count;
+    r->id       = rule_id;
+    r->wildcard = wildcard;
+    m->rule_count++;
+
+    *err_out = NO_UPARSE_ERROR;
+    return true;
+}
+
+// The label of a reversed key at or after *at, which is moved past it.
+static size_t next_label(char const *key,size_t key_len,size_t *at,char const **label_out) {
+    size_t const start = *at;
+    size_t end = start;
+    while ((end < key_len) && (LABEL_DELIM != key[end])) {
+        end++;
+    }
+    *label_out = key + start;
+    *at = (end < key_len) ? end + 1 : end;
+    return end - start;
+}
+
+// The label depth places from the right of a rule's host.
+static size_t rule_label(match_rule_t const *r,size_t depth,char const **label_out) {
+    size_t at = 0;
+    size_t len = 0;
+    for (size_t d = 0; d <= depth; d++) {
+        len = next_label(r->key,r->key_len,&at,label_out);
+    }
+    return len;
+}
+
+// Sort by host label by label, a host before the hosts below it, then
+// exact rules before wildcards, then by path with a prefix first, then in
+// the order added.
+static int rule_cmp(void const *a,void const *b) {
+    match_rule_t const *x = (match_rule_t const *) a;
+    match_rule_t const *y = (match_rule_t const *) b;
+
+    size_t xi = 0;
+    size_t yi = 0;
+    size_t const labels = (x->labels < y->labels) ? x->labels : y->labels;
+    for (size_t d = 0; d < labels; d++) {
+        char const *xl = NULL;
+        char const *yl = NULL;
+        size_t const xl_len = next_label(x->key,x->key_len,&xi,&xl);
+        size_t const yl_len = next_label(y->key,y->key_len,&yi,&yl);
+        int const cmp = uparse_label_cmp(xl,xl_len,yl,yl_len);
+        if (0 != cmp) {
+            return cmp;
+        }
+    }
+    if (x->labels != y->labels) {
+        return (x->labels < y->labels) ? -1 : 1;
+    }
+    if (x->wildcard != y->wildcard) {
+        return x->wildcard ? 1 : -1;
+    }
+    size_t const len = (x->path_len < y->path_len) ? x->path_len : y->path_len;
+    int const cmp = memcmp(x->path,y->path,len);
+    if (0 != cmp) {
+        return cmp;
+    }
+    if (x->path_len != y->path_len) {
+        return (x->path_len < y->path_len) ? -1 : 1;
+    }
+    return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+// Compile the paths of rules[lo,hi), which share a host and kind and are
+// sorted, from byte offset on. Returns the path node, or NO_NODE if out of
+// memory.
+static uint32_t compile_paths(uparse_matcher_t *m,match_rule_t const *rules,size_t lo,size_t hi,size_t offset) {
+
+    size_t idx = 0;
+    if (!uparse_reserve((void **) &m->paths,&m->path_cap,&m->path_count,1,sizeof(path_node_t),&idx)) {
+        return NO_NODE;
+    }
+    m->paths[idx].id = NO_MATCH_ID;
+
+    // A path that ends here sorts first; the ones after it are duplicates.
+    if (rules[lo].path_len == offset) {
+        m->paths[idx].id = rules[lo].id;
+        while ((lo < hi) && (rules[lo].path_len == offset)) {
+            lo++;
+        }
+    }
+
+    size_t edge_count = 0;
+    for (size_t i = lo; i < hi; edge_count++) {
+        char const c = rules[i].path[offset];
+        while ((i < hi) && (c == rules[i].path[offset])) {
+            i++;
+        }
+    }
+
+    // One edge per distinct next byte, in byte order since the run is
+    // sorted; match_paths binary searches them by that byte.
+    size_t first_edge = 0;
+    if (!uparse_reserve((void **) &m->edges,&m->edge_cap,&m->edge_count,edge_count,sizeof(path_edge_t),&first_edge)) {
+        return NO_NODE;
+    }
+    m->paths[idx].first_edge = (uint32_t) first_edge;
+    m->paths[idx].edge_count = (uint32_t) edge_count;
+
+    size_t e = first_edge;
+    for (size_t i = lo; i < hi; e++) {
+        size_t j = i;
+        char const c = rules[i].path[offset];
+        while ((j < hi) && (c == rules[j].path[offset])) {
+            j++;
+        }
+
+        // The prefix common to a sorted run is the one common to its first
+        // and last, and no path of the run ends inside it.
+        match_rule_t const *first = &rules[i];
+        match_rule_t const *last = &rules[j - 1];
+        size_t len = 1;
+        while ((offset + len < first->path_len) && (first->path[offset + len] == last->path[offset + len])) {
+            len++;
+        }
+
+        if (!uparse_grow((void **) &m->path_labels,&m->path_labels_cap,m->path_labels_len + len,1)) {
+            return NO_NODE;
+        }
+        uint32_t const label_off = (uint32_t) m->path_labels_len;
+        memcpy(m->path_labels + m->path_labels_len,first->path + offset,len);
+        m->path_labels_len += len;
+
+        uint32_t const child = compile_paths(m,rules,i,j,offset + len);
+        if (NO_NODE == child) {
+            return NO_NODE;
+        }
+        m->edges[e].label_off = label_off;
+        m->edges[e].label_len = (uint32_t) len;
+        m->edges[e].child     = child;
+        i = j;
+    }
+    return (uint32_t) idx;
+}
+
+// Set the id and path tree of one kind of rule on a host from the sorted
+// run rules[lo,hi). The rules with no path come first and set the id.
+static bool compile_host_rules(uparse_matcher_t *m,match_rule_t const *rules,size_t lo,size_t hi,
+                               unsigned int *id_out,uint32_t *paths_out) {
+    *id_out = NO_MATCH_ID;
+    *paths_out = NO_NODE;
+    if ((lo < hi) && (0 == rules[lo].path_len)) {
+        *id_out = rules[lo].id;
+        while ((lo < hi) && (0 == rules[lo].path_len)) {
+            lo++;
+        }
+    }
+    if (lo < hi) {
+        *paths_out = compile_paths(m,rules,lo,hi,0);
+        if (NO_NODE == *paths_out) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The end of the run of rules from i with the same label depth places
+// from the right.
+static size_t label_run_end(match_rule_t const *rules,size_t i,size_t hi,size_t depth) {
+    char const *label = NULL;
+    size_t const len = rule_label(&rules[i],depth,&label);
+    for (i++; i < hi; i++) {
+        char const *next = NULL;
+        size_t const next_len = rule_label(&rules[i],depth,&next);
+        if (0 != uparse_label_cmp(label,len,next,next_len)) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Fill in host node idx from rules[lo,hi), the sorted rules whose hosts
+// have the depth labels leading to it, then lay out its children.
+static bool compile_host(uparse_matcher_t *m,size_t lo,size_t hi,size_t depth,uint32_t idx) {
+
+    match_rule_t const *const rules = m->rules;
+
+    // The rules on this very host sort first, exact ones before wildcards.
+    size_t exact_end = lo;
+    while ((exact_end < hi) && (depth == rules[exact_end].labels) && !rules[exact_end].wildcard) {
+        exact_end++;
+    }
+    size_t sub_end = exact_end;
+    while ((sub_end < hi) && (depth == rules[sub_end].labels)) {
+        sub_end++;
+    }
+
+    unsigned int exact_id = NO_MATCH_ID;
+    unsigned int sub_id = NO_MATCH_ID;
+    uint32_t exact_paths = NO_NODE;
+    uint32_t sub_paths = NO_NODE;
+    if (!compile_host_rules(m,rules,lo,exact_end,&exact_id,&exact_paths) ||
+        !compile_host_rules(m,rules,exact_end,sub_end,&sub_id,&sub_paths)) {
+        return false;
+    }
+
+    size_t child_count = 0;
+    for (size_t i = sub_end; i < hi; child_count++) {
+        i = label_run_end(rules,i,hi,depth);
+    }
+
+    // One child per distinct next label, already in uparse_label_cmp order
+    // as rule_cmp sorted the rules by it; find_host binary searches them.
+    size_t first_child = 0;
+    if (!uparse_reserve((void **) &m->hosts,&m->host_cap,&m->host_count,child_count,sizeof(host_node_t),
+                        &first_child)) {
+        return false;
+    }
+
+    host_node_t *n = &m->hosts[idx];
+    n->first_child = (uint32_t) first_child;
+    n->child_count = (uint32_t) child_count;
+    n->exact_paths = exact_paths;
+    n->sub_paths   = sub_paths;
+    n->exact_id    = exact_id;
+    n->sub_id      = sub_id;
+
+    uint32_t c = (uint32_t) first_child;
+    for (size_t i = sub_end; i < hi; c++) {
+        char const *label = NULL;
+        size_t const len = rule_label(&rules[i],depth,&label);
+        size_t const j = label_run_end(rules,i,hi,depth);
+
+        if (!uparse_grow((void **) &m->host_labels,&m->host_labels_cap,m->host_labels_len + len,1)) {
+            return false;
+        }
+        m->hosts[c].label_off = (uint32_t) m->host_labels_len;
+        m->hosts[c].label_len = (uint8_t) len;
+        memcpy(m->host_labels + m->host_labels_len,label,len);
+        m->host_labels_len += len;
+
+        if (!compile_host(m,i,j,depth + 1,c)) {
+            return false;
+        }
+        i = j;
+    }
+    return true;
+}
+
+// FNV-1a over host from end back to start, lowercased, so the hash of each
+// suffix is found on the way to the hash of the whole host.
+static uint64_t hash_step(uint64_t h,char c) {
+    return uparse_fnv1a_step(h,uparse_lower(c));
+}
+
+static uint64_t const *bloom_block(uparse_matcher_t const *m,uint64_t h) {
+    return m->bloom + (BLOOM_BLOCK_WORDS * (size_t) (((h >> 32) * m->bloom_blocks) >> 32));
+}
+
+static void bloom_add(uparse_matcher_t *m,uint64_t h) {
+    uint64_t *block = (uint64_t *) bloom_block(m,h);
+    uint64_t const bits = h * 0x9E3779B97F4A7C15ULL;
+    for (unsigned int i = 0; i < BLOOM_K; i++) {
+        unsigned int const bit = (unsigned int) (bits >> (9 * i)) & 511;
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+static bool bloom_test(uparse_matcher_t const *m,uint64_t h) {
+    uint64_t const *block = bloom_block(m,h);
+    uint64_t const bits = h * 0x9E3779B97F4A7C15ULL;
+    for (unsigned int i = 0; i < BLOOM_K; i++) {
+        unsigned int const bit = (unsigned int) (bits >> (9 * i)) & 511;
+        if (0 == (block[bit >> 6] & (1ULL << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool uparse_matcher_compile(uparse_matcher_t *m,size_t bloom_bits_per_rule,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if (NULL == m) {
+        fprintf(stderr,"matcher is null\n");
+        return false;
+    }
+    if (m->compiled) {
+        fprintf(stderr,"matcher is already compiled\n");
+        return false;
+    }
+
+    if (0 != m->rule_count) {
+        qsort((void *) m->rules,m->rule_count,sizeof(match_rule_t),rule_cmp);
+    }
+
+    // The root stands for the empty host.
+    if (!uparse_grow((void **) &m->hosts,&m->host_cap,1,sizeof(host_node_t))) {
+        fprintf(stderr,"cannot allocate matcher nodes\n");
+        return false;
+    }
+    m->host_count = 1;
+    m->hosts[0].label_off = 0;
+    m->hosts[0].label_len = 0;
+    if (!compile_host(m,0,m->rule_count,0,0)) {
+        fprintf(stderr,"cannot allocate matcher nodes\n");
+        return false;
+    }
+
+    // Add the host of every node below the root, found as the suffixes of
+    // the rule hosts. The keys have the labels reversed, so each label is
+    // hashed from its end.
+    if ((0 != bloom_bits_per_rule) && (1 < m->host_count)) {
+        size_t const bits = (m->host_count - 1) * bloom_bits_per_rule;
+        m->bloom_blocks = (bits + (64 * BLOOM_BLOCK_WORDS) - 1) / (64 * BLOOM_BLOCK_WORDS);
+        if (UINT32_MAX < m->bloom_blocks) {
+            m->bloom_blocks = UINT32_MAX;
+        }
+        m->bloom = (uint64_t *) calloc(m->bloom_blocks * BLOOM_BLOCK_WORDS,sizeof(uint64_t));
+        if (NULL == m->bloom) {
+            fprintf(stderr,"cannot allocate bloom filter\n");
+            m->bloom_blocks = 0;
+            return false;
+        }
+        for (size_t i = 0; i < m->rule_count; i++) {
+            match_rule_t const *r = &m->rules[i];
+            uint64_t h = UPARSE_FNV_OFFSET;
+            size_t at = 0;
+            for (size_t d = 0; d < r->labels; d++) {
+                char const *label = NULL;
+                size_t const len = next_label(r->key,r->key_len,&at,&label);
+                if (0 != d) {
+                    h = hash_step(h,LABEL_DELIM);
+                }
+                for (size_t k = len; k > 0; k--) {
+                    h = hash_step(h,label[k - 1]);
+                }
+                bloom_add(m,h);
+            }
+        }
+    }
+
+    free_rules(m);
+    m->compiled = true;
+    *err_out = NO_UPARSE_ERROR;
+    return true;
+}
+
+// The child of host node idx labelled with the len chars at label, or NO_NODE.
+static uint32_t find_host(uparse_matcher_t const *m,uint32_t idx,char const *label,size_t len) {
+
+    if (UINT8_MAX < len) {
+        return NO_NODE;
+    }
+    char lowered[UINT8_MAX];
+    uparse_lowercase(lowered,label,len);
+
+    host_node_t const *const n = &m->hosts[idx];
+    uint32_t lo = n->first_child;
+    uint32_t hi = n->first_child + n->child_count;
+    while (lo < hi) {
+        uint32_t const mid = lo + ((hi - lo) / 2);
+        host_node_t const *c = &m->hosts[mid];
+        int const cmp = uparse_label_cmp(m->host_labels + c->label_off,c->label_len,lowered,len);
+        if (0 == cmp) {
+            return mid;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NO_NODE;
+}
+
+// The id of the longest prefix of path in the tree at node, or id if none.
+static unsigned int match_paths(uparse_matcher_t const *m,uint32_t node,unsigned int id,
+                                char const *path,size_t len) {
+    size_t at = 0;
+    while (NO_NODE != node) {
+        path_node_t const *const n = &m->paths[node];
+        if (NO_MATCH_ID != n->id) {
+            id = n->id;
+        }
+        if (at == len) {
+            break;
+        }
+
+        // Edges out of a node start with distinct bytes.
+        uint32_t lo = n->first_edge;
+        uint32_t hi = n->first_edge + n->edge_count;
+        path_edge_t const *e = NULL;
+        while (lo < hi) {
+            uint32_t const mid = lo + ((hi - lo) / 2);
+            char const c = m->path_labels[m->edges[mid].label_off];
+            if (c == path[at]) {
+                e = &m->edges[mid];
+                break;
+            } else if ((unsigned char) c < (unsigned char) path[at]) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if ((NULL == e) || (len - at < e->label_len) ||
+            (0 != memcmp(m->path_labels + e->label_off,path + at,e->label_len))) {
+            break;
+        }
+        at += e->label_len;
+        node = e->child;
+    }
+    return id;
+}
+
+unsigned int uparse_matcher_match(uparse_matcher_t const *m,uparse_span_t host,uparse_span_t path) {
+
+    if ((NULL == m) || !m->compiled || (NULL == host.ptr) || (0 == host.len)) {
+        return NO_MATCH_ID;
+    }
+    char const *p = path.ptr;
+    size_t p_len = path.len;
+    if (NULL == p) {
+        p = "/";
+        p_len = 1;
+    }
+
+    char const *const start = host.ptr;
+    char const *end = host.ptr + host.len;
+    if (LABEL_DELIM == end[-1]) {
+        end--;
+    }
+
+    unsigned int best = NO_MATCH_ID;
+    uint32_t node = 0;
+    uint64_t h = UPARSE_FNV_OFFSET;
+    char const *label_end = end;
+    for (;;) {
+        char const *label = label_end;
+        while ((label > start) && (LABEL_DELIM != label[-1])) {
+            label--;
+        }
+        size_t const len = (size_t) (label_end - label);
+        if (0 == len) {
+            return NO_MATCH_ID;
+        }
+
+        // The host goes on below this node, so its wildcard rules apply.
+        host_node_t const *const n = &m->hosts[node];
+        if ((NO_MATCH_ID != n->sub_id) || (NO_NODE != n->sub_paths)) {
+            unsigned int const id = match_paths(m,n->sub_paths,n->sub_id,p,p_len);
+            if (NO_MATCH_ID != id) {
+                best = id;
+            }
+        }
+
+        // Before searching many children, ask the filter whether the host
+        // so far is a node at all.
+        if (NULL != m->bloom) {
+            if (label_end != end) {
+                h = hash_step(h,LABEL_DELIM);
+            }
+            for (char const *c = label_end; c > label; c--) {
+                h = hash_step(h,c[-1]);
+            }
+            if ((BLOOM_MIN_CHILDREN <= n->child_count) && !bloom_test(m,h)) {
+                return best;
+            }
+        }
+
+        node = find_host(m,node,label,len);
+        if (NO_NODE == node) {
+            return best;
+        }
+        if (label == start) {
+            break;
+        }
+        label_end = label - 1;
+    }
+
+    host_node_t const *const n = &m->hosts[node];
+    unsigned int const id = match_paths(m,n->exact_paths,n->exact_id,p,p_len);
+    return (NO_MATCH_ID != id) ? id : best;
+}
+
+unsigned int uparse_matcher_match_url(uparse_matcher_t const *m,url_t const *url) {
+    if ((NULL == url) || (NULL == url->host)) {
+        return NO_MATCH_ID;
+    }
+    uparse_span_t const host = {url->host,strlen(url->host)};
+    uparse_span_t path = {NULL,0};
+    if (NULL != url->path) {
+        path.ptr = url->path;
+        path.len = strlen(url->path);
+    }
+    return uparse_matcher_match(m,host,path);
+}
+
+size_t uparse_matcher_bytes(uparse_matcher_t const *m) {
+    return sizeof(uparse_matcher_t) +
+        (m->host_count * sizeof(host_node_t)) + m->host_labels_len +
+        (m->path_count * sizeof(path_node_t)) + (m->edge_count * sizeof(path_edge_t)) + m->path_labels_len +
+        (m->bloom_blocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t));
+}
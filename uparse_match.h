@@ -0,0 +1,41 @@
+#ifndef UPARSE_MATCH_H
+#define UPARSE_MATCH_H
+
+#include "uparse.h"
+
+// rule ids start at 1, so 0 means "no rule matched"
+#define NO_MATCH_ID 0
+
+// a set of host and path rules, such as a blocklist, compiled for matching
+// urls. a rule is one of
+//   "example.com"            the host example.com
+//   "*.example.com"          any host below example.com, such as www.example.com
+//   "example.com/ads/"       the host example.com with a path starting "/ads/"
+//   "*.example.com/ads/"     any host below example.com with such a path
+// hosts are matched without regard to ascii case, paths byte for byte.
+// when several rules match, the one with the longest host wins (an exact
+// host beating a wildcard on the same host), then the one with the longest
+// path prefix, so an allow rule can carve an exception out of a block rule.
+// if the same rule is added twice, the first id is kept.
+typedef struct uparse_matcher_t uparse_matcher_t;
+
+uparse_matcher_t *uparse_matcher_new(void);
+void uparse_matcher_free(uparse_matcher_t *m);
+bool uparse_matcher_add(uparse_matcher_t *m,char const *rule,unsigned int rule_id,unsigned int *err_out);
+
+// compile the rules added so far; no rules can be added after. if
+// bloom_bits_per_rule is not 0, a bloom filter of about that many bits per
+// rule host lets most hosts that match no rule skip searching the wide
+// levels of the trie, such as the children of "com".
+bool uparse_matcher_compile(uparse_matcher_t *m,size_t bloom_bits_per_rule,unsigned int *err_out);
+
+// the id of the rule matching host and path (a NULL path is "/"), or
+// NO_MATCH_ID. these only read the compiled matcher and allocate nothing,
+// so any number of threads may match at once.
+unsigned int uparse_matcher_match(uparse_matcher_t const *m,uparse_span_t host,uparse_span_t path);
+unsigned int uparse_matcher_match_url(uparse_matcher_t const *m,url_t const *url);
+
+// the bytes held by a compiled matcher
+size_t uparse_matcher_bytes(uparse_matcher_t const *m);
+
+#endif
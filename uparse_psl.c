@@ -0,0 +1,401 @@
+#include <stdint.h>
+#include "uparse_psl.h"
+#include "uparse_internal.h"
+
+// -----------------------------------------
+// PUBLIC SUFFIXES
+
+// Rules are first added to a plain trie keyed by host label, rightmost label
+// first, so "co.uk" is uk -> co. Compiling flattens it into one array of
+// nodes in which the children of a node are contiguous and sorted, so a
+// lookup binary searches each level and touches no pointers. The label
+// bytes of all nodes are kept together in one string.
+//
+// A "*.ck" rule marks the ck node PSL_WILDCARD, and a "!www.ck" rule adds
+// a www child under it marked PSL_EXCEPTION.
+
+static char const LABEL_DELIM    = '.';
+static char const WILDCARD_LABEL = '*';
+static char const EXCEPTION_MARK = '!';
+
+#define PSL_RULE      0x01
+#define PSL_WILDCARD  0x02
+#define PSL_EXCEPTION 0x04
+
+// Hosts are at most UPARSE_MAX_HOST_LEN chars, so they have fewer labels.
+#define PSL_MAX_LABELS UPARSE_MAX_HOST_LEN
+
+static uint32_t const NO_NODE = UINT32_MAX;
+
+typedef struct psl_node_t {
+    uint32_t label_off;
+    uint32_t first_child;
+    uint32_t child_count;
+    uint8_t  label_len;
+    uint8_t  flags;
+} psl_node_t;
+
+struct uparse_psl_t {
+    psl_node_t *nodes;
+    size_t     node_count;
+    char       *labels;
+    size_t     labels_len;
+    size_t     rule_count;
+};
+
+// Add one rule, given as the len chars at rule. Returns false on a
+// malformed rule or allocation failure.
+static bool add_rule(uparse_build_node_t *root,char const *rule,size_t len,size_t *nodes_io,size_t *labels_io) {
+
+    unsigned int flags = PSL_RULE;
+    if ((0 < len) && (EXCEPTION_MARK == rule[0])) {
+        flags = PSL_EXCEPTION;
+        rule++;
+        len--;
+    }
+
+    uparse_build_node_t *node = root;
+    char const *end = rule + len;
+
+    for (;;) {
+        char const *start = end;
+        while ((start > rule) && (LABEL_DELIM != start[-1])) {
+            start--;
+        }
+        size_t const label_len = (size_t) (end - start);
+        if ((0 == label_len) || (UINT8_MAX < label_len)) {
+            fprintf(stderr,"rule %.*s has an empty or long label\n",(int) len,rule);
+            return false;
+        }
+
+        // A wildcard may only be the leftmost label of a plain rule.
+        if ((1 == label_len) && (WILDCARD_LABEL == start[0])) {
+            if ((start != rule) || (PSL_RULE != flags) || (node == root)) {
+                fprintf(stderr,"rule %.*s has a misplaced wildcard\n",(int) len,rule);
+                return false;
+            }
+            node->flags |= PSL_WILDCARD;
+            return true;
+        }
+
+        char label[UINT8_MAX];
+        uparse_lowercase(label,start,label_len);
+
+        uparse_build_node_t *const parent = node;
+        size_t const child_count = parent->child_count;
+        node = uparse_build_node_child(parent,label,label_len);
+        if (NULL == node) {
+            fprintf(stderr,"cannot allocate psl node\n");
+            return false;
+        }
+        if (child_count != parent->child_count) {
+            (*nodes_io)++;
+            *labels_io += label_len;
+        }
+
+        if (start == rule) {
+            break;
+        }
+        end = start - 1;
+    }
+
+    node->flags |= flags;
+    return true;
+}
+
+// Lay out the children of b, already placed at nodes[idx], after the
+// nodes placed so far, then their children in turn.
+static bool compile_node(uparse_psl_t *psl,uparse_build_node_t const *b,uint32_t idx) {
+
+    psl_node_t *n = &psl->nodes[idx];
+    n->flags       = (uint8_t) b->flags;
+    n->label_len   = (uint8_t) b->len;
+    n->label_off   = (uint32_t) psl->labels_len;
+    n->child_count = (uint32_t) b->child_count;
+    n->first_child = (uint32_t) psl->node_count;
+    if (0 != b->len) {
+        memcpy(psl->labels + psl->labels_len,b->label,b->len);
+        psl->labels_len += b->len;
+    }
+
+    if (0 == b->child_count) {
+        return true;
+    }
+
+    uparse_build_node_t const **children = uparse_build_node_sorted(b);
+    if (NULL == children) {
+        return false;
+    }
+
+    uint32_t const first = (uint32_t) psl->node_count;
+    psl->node_count += b->child_count;
+    for (size_t k = 0; k < b->child_count; k++) {
+        if (!compile_node(psl,children[k],first + (uint32_t) k)) {
+            free((void *) children);
+            return false;
+        }
+    }
+    free((void *) children);
+    return true;
+}
+
+// Load a list in the publicsuffix.org format: one rule per line, "//"
+// comments and blank lines ignored, and only the text up to the first
+// whitespace of a line read.
+
+uparse_psl_t *uparse_psl_load_buffer(char const *buf,size_t len,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if (NULL == buf) {
+        fprintf(stderr,"input buf is null\n");
+        return NULL;
+    }
+
+    uparse_build_node_t *root = uparse_build_node_new(NULL,0);
+    if (NULL == root) {
+        fprintf(stderr,"cannot allocate psl root\n");
+        return NULL;
+    }
+
+    size_t node_count = 1;
+    size_t labels_len = 0;
+    size_t rule_count = 0;
+    size_t i = 0;
+    while (i < len) {
+        while ((i < len) && isspace((unsigned char) buf[i])) {
+            i++;
+        }
+        size_t const start = i;
+        while ((i < len) && !isspace((unsigned char) buf[i])) {
+            i++;
+        }
+        size_t const rule_len = i - start;
+        // Skip the rest of the line.
+        while ((i < len) && ('\n' != buf[i])) {
+            i++;
+        }
+        if ((0 == rule_len) || ((2 <= rule_len) && ('/' == buf[start]) && ('/' == buf[start + 1]))) {
+            continue;
+        }
+        if (!add_rule(root,buf + start,rule_len,&node_count,&labels_len)) {
+            uparse_build_node_free(root);
+            return NULL;
+        }
+        rule_count++;
+    }
+
+    uparse_psl_t *psl = (uparse_psl_t *) calloc(1,sizeof(uparse_psl_t));
+    if (NULL != psl) {
+        psl->nodes  = (psl_node_t *) calloc(node_count,sizeof(psl_node_t));
+        psl->labels = (char *) malloc(labels_len + 1);
+    }
+    if ((NULL == psl) || (NULL == psl->nodes) || (NULL == psl->labels)) {
+        fprintf(stderr,"cannot allocate psl\n");
+        uparse_build_node_free(root);
+        uparse_psl_free(psl);
+        return NULL;
+    }
+    psl->rule_count = rule_count;
+    psl->node_count = 1;
+    if (!compile_node(psl,root,0)) {
+        fprintf(stderr,"cannot allocate psl\n");
+        uparse_build_node_free(root);
+        uparse_psl_free(psl);
+        return NULL;
+    }
+    uparse_build_node_free(root);
+
+    *err_out = NO_UPARSE_ERROR;
+    return psl;
+}
+
+uparse_psl_t *uparse_psl_load(char const *path,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    FILE *f = fopen(path,"rb");
+    if (NULL == f) {
+        fprintf(stderr,"cannot open %s\n",path);
+        return NULL;
+    }
+    char *buf = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    for (;;) {
+        if (len == cap) {
+            size_t const new_cap = (0 == cap) ? 65536 : cap * 2;
+            char *p = (char *) realloc(buf,new_cap);
+            if (NULL == p) {
+                fprintf(stderr,"cannot allocate buffer for %s\n",path);
+                free(buf);
+                fclose(f);
+                return NULL;
+            }
+            buf = p;
+            cap = new_cap;
+        }
+        size_t const n = fread(buf + len,1,cap - len,f);
+        if (0 == n) {
+            break;
+        }
+        len += n;
+    }
+    bool const read_err = (0 != ferror(f));
+    fclose(f);
+    if (read_err) {
+        fprintf(stderr,"cannot read %s\n",path);
+        free(buf);
+        return NULL;
+    }
+
+    uparse_psl_t *psl = uparse_psl_load_buffer(buf,len,err_out);
+    free(buf);
+    return psl;
+}
+
+void uparse_psl_free(uparse_psl_t *psl) {
+    if (NULL == psl) {
+        return;
+    }
+    free(psl->nodes);
+    free(psl->labels);
+    free(psl);
+}
+
+size_t uparse_psl_rule_count(uparse_psl_t const *psl) {
+    return psl->rule_count;
+}
+
+// The child of node labelled with the len chars at label, or NO_NODE.
+static uint32_t find_child(uparse_psl_t const *psl,psl_node_t const *node,char const *label,size_t len) {
+
+    if (UINT8_MAX < len) {
+        return NO_NODE;
+    }
+    char lowered[UINT8_MAX];
+    uparse_lowercase(lowered,label,len);
+
+    uint32_t lo = node->first_child;
+    uint32_t hi = node->first_child + node->child_count;
+    while (lo < hi) {
+        uint32_t const mid = lo + ((hi - lo) / 2);
+        psl_node_t const *m = &psl->nodes[mid];
+        int const cmp = uparse_label_cmp(psl->labels + m->label_off,m->label_len,lowered,len);
+        if (0 == cmp) {
+            return mid;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NO_NODE;
+}
+
+// Walk host from its rightmost label, following the public suffix
+// algorithm: the longest matching rule wins, an exception rule beats a
+// wildcard, and with no match the suffix is the last label. starts[i] is
+// set to the start of the label i places from the right, up to one label
+// past the suffix. Returns the number of suffix labels, or 0 if host is not
+// a name; *labels_out is the number of starts set.
+
+static size_t find_suffix(uparse_psl_t const *psl,char const *host,char const *end,
+                          char const *starts[PSL_MAX_LABELS],size_t *labels_out) {
+
+    *labels_out = 0;
+
+    size_t suffix = 1;
+    size_t n = 0;
+    uint32_t node = 0;
+    char const *label_end = end;
+
+    while (n < PSL_MAX_LABELS) {
+
+        char const *start = label_end;
+        while ((start > host) && (LABEL_DELIM != start[-1])) {
+            start--;
+        }
+        size_t const len = (size_t) (label_end - start);
+        if (0 == len) {
+            return 0;
+        }
+        starts[n++] = start;
+
+        if (NO_NODE != node) {
+            psl_node_t const *const parent = &psl->nodes[node];
+            node = find_child(psl,parent,start,len);
+            if ((NO_NODE != node) && (0 != (psl->nodes[node].flags & PSL_EXCEPTION))) {
+                suffix = n - 1;
+                node = NO_NODE;
+            } else {
+                if (0 != (parent->flags & PSL_WILDCARD)) {
+                    suffix = n;
+                }
+                if ((NO_NODE != node) && (0 != (psl->nodes[node].flags & PSL_RULE))) {
+                    suffix = n;
+                }
+            }
+        }
+
+        // Once matching has stopped only the label before the suffix is needed.
+        if (((NO_NODE == node) && (n > suffix)) || (start == host)) {
+            break;
+        }
+        label_end = start - 1;
+    }
+
+    *labels_out = n;
+    return suffix;
+}
+
+// Trim a trailing '.' and reject hosts that are address literals.
+static bool host_bounds(uparse_span_t host,char const **end_out) {
+    if ((NULL == host.ptr) || (0 == host.len) || ('[' == host.ptr[0])) {
+        return false;
+    }
+    size_t len = host.len;
+    if (LABEL_DELIM == host.ptr[len - 1]) {
+        len--;
+    }
+    uint32_t addr = 0;
+    if ((0 == len) || uparse_parse_ipv4(host.ptr,len,&addr)) {
+        return false;
+    }
+    *end_out = host.ptr + len;
+    return true;
+}
+
+uparse_span_t uparse_psl_public_suffix(uparse_psl_t const *psl,uparse_span_t host) {
+    uparse_span_t span = {NULL,0};
+    char const *end = NULL;
+    if (!host_bounds(host,&end)) {
+        return span;
+    }
+    char const *starts[PSL_MAX_LABELS];
+    size_t labels = 0;
+    size_t const suffix = find_suffix(psl,host.ptr,end,starts,&labels);
+    if ((0 == suffix) || (labels < suffix)) {
+        return span;
+    }
+    span.ptr = starts[suffix - 1];
+    span.len = (size_t) (end - span.ptr);
+    return span;
+}
+
+uparse_span_t url_registrable_domain(uparse_psl_t const *psl,uparse_span_t host) {
+    uparse_span_t span = {NULL,0};
+    char const *end = NULL;
+    if (!host_bounds(host,&end)) {
+        return span;
+    }
+    char const *starts[PSL_MAX_LABELS];
+    size_t labels = 0;
+    size_t const suffix = find_suffix(psl,host.ptr,end,starts,&labels);
+    if ((0 == suffix) || (labels <= suffix)) {
+        return span;
+    }
+    span.ptr = starts[suffix];
+    span.len = (size_t) (end - span.ptr);
+    return span;
+}
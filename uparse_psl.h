@@ -0,0 +1,24 @@
+#ifndef UPARSE_PSL_H
+#define UPARSE_PSL_H
+
+#include "uparse.h"
+
+// a public suffix list (https://publicsuffix.org/list/) compiled into a trie
+// of reversed host labels. once loaded it is never modified, so any number of
+// threads may look hosts up in it at once without locking.
+typedef struct uparse_psl_t uparse_psl_t;
+
+uparse_psl_t *uparse_psl_load(char const *path,unsigned int *err_out);
+uparse_psl_t *uparse_psl_load_buffer(char const *buf,size_t len,unsigned int *err_out);
+void uparse_psl_free(uparse_psl_t *psl);
+size_t uparse_psl_rule_count(uparse_psl_t const *psl);
+
+// the public suffix ("co.uk") and registrable domain ("example.co.uk") of a
+// host such as "www.example.co.uk", as spans into host. hosts are matched
+// without regard to ascii case and may end in a '.', which is left out.
+// the span has a NULL ptr if there is none: the host is itself a public
+// suffix, is an address literal or has an empty label. nothing is allocated.
+uparse_span_t uparse_psl_public_suffix(uparse_psl_t const *psl,uparse_span_t host);
+uparse_span_t url_registrable_domain(uparse_psl_t const *psl,uparse_span_t host);
+
+#endif
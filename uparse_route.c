@@ -0,0 +1,409 @@
+#include <stdint.h>
+#include "uparse_route.h"
+#include "uparse_internal.h"
+
+// -----------------------------------------
+// ROUTE MATCHING
+
+// Patterns are first added to a plain trie with one node per path segment.
+// Compiling flattens it into two arrays: nodes, and the edges out of them.
+// Chains of static segments with no branching are merged into one edge
+// ("api/v1/users"), and the static edges out of a node are sorted by their
+// first segment so matching can binary search them.
+
+static char const PATH_DELIM  = '/';
+static char const PARAM_MARK  = ':';
+static char const WILDCARD_MARK = '*';
+
+static uint32_t const NO_NODE = UINT32_MAX;
+
+typedef struct route_node_t {
+    uint32_t     first_edge;
+    uint32_t     edge_count;
+    uint32_t     param_child;
+    unsigned int route_id;
+    unsigned int wildcard_route_id;
+} route_node_t;
+
+typedef struct route_edge_t {
+    uint32_t label_off;
+    uint32_t label_len;
+    uint32_t first_len;
+    uint32_t seg_count;
+    uint32_t child;
+} route_edge_t;
+
+struct uparse_router_t {
+    uparse_build_node_t *root;
+    route_node_t        *nodes;
+    size_t              node_count;
+    size_t              node_cap;
+    route_edge_t        *edges;
+    size_t              edge_count;
+    size_t              edge_cap;
+    char                *labels;
+    size_t              labels_len;
+    size_t              labels_cap;
+    bool                compiled;
+    uparse_policy_t     policy;
+    uint8_t const       *classes;
+};
+
+uparse_router_t *uparse_router_new(void) {
+    return uparse_router_new_ex(UPARSE_DEFAULT_POLICY);
+}
+
+// Pattern segments and matched paths may have the path chars of policy.
+uparse_router_t *uparse_router_new_ex(uparse_policy_t policy) {
+    uint8_t const *const classes = uparse_char_classes(policy);
+    if (NULL == classes) {
+        fprintf(stderr,"unknown policy %u\n",(unsigned int) policy);
+        return NULL;
+    }
+    uparse_router_t *router = (uparse_router_t *) calloc(1,sizeof(uparse_router_t));
+    if (NULL == router) {
+        fprintf(stderr,"cannot allocate router\n");
+        return NULL;
+    }
+    router->policy = policy;
+    router->classes = classes;
+    router->root = uparse_build_node_new(NULL,0);
+    if (NULL == router->root) {
+        fprintf(stderr,"cannot allocate router root\n");
+        free(router);
+        return NULL;
+    }
+    return router;
+}
+
+void uparse_router_free(uparse_router_t *router) {
+    if (NULL == router) {
+        return;
+    }
+    uparse_build_node_free(router->root);
+    free(router->nodes);
+    free(router->edges);
+    free(router->labels);
+    free(router);
+}
+
+// Add a pattern. Segments are literal, ":name" to capture one nonempty
+// segment, or "*name" as the last segment to capture one or more trailing
+// segments. route_id must not be NO_ROUTE_ID.
+bool uparse_router_add(uparse_router_t *router,char const *pattern,unsigned int route_id,
+                       unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == router) || (NULL == pattern) || (NO_ROUTE_ID == route_id)) {
+        fprintf(stderr,"router, pattern and route_id must be set\n");
+        return false;
+    }
+    if (router->compiled) {
+        fprintf(stderr,"cannot add %s to a compiled router\n",pattern);
+        return false;
+    }
+    if (PATH_DELIM != pattern[0]) {
+        fprintf(stderr,"pattern %s does not start with %c\n",pattern,PATH_DELIM);
+        return false;
+    }
+
+    uparse_build_node_t *node = router->root;
+    size_t params = 0;
+
+    // The vacuous pattern "/" has no segments.
+    char const *c = ('\0' == pattern[1]) ? NULL : pattern;
+
+    while (NULL != c) {
+
+        // Advance past the '/' and find the end of the segment.
+        c++;
+        char const *const seg = c;
+        while (*c && (PATH_DELIM != c[0])) {
+            c++;
+        }
+        size_t const len = (size_t) (c - seg);
+        if ('\0' == c[0]) {
+            c = NULL;
+        }
+
+        if ((len > 0) && ((PARAM_MARK == seg[0]) || (WILDCARD_MARK == seg[0]))) {
+            if (UPARSE_ROUTE_MAX_PARAMS == params) {
+                fprintf(stderr,"pattern %s has more than %d params\n",pattern,UPARSE_ROUTE_MAX_PARAMS);
+                return false;
+            }
+            params++;
+        }
+
+        if ((len > 0) && (WILDCARD_MARK == seg[0])) {
+            if (NULL != c) {
+                fprintf(stderr,"wildcard is not the last segment of %s\n",pattern);
+                return false;
+            }
+            if (NO_ROUTE_ID != node->wildcard_route_id) {
+                fprintf(stderr,"pattern %s is already routed\n",pattern);
+                return false;
+            }
+            node->wildcard_route_id = route_id;
+            *err_out = NO_UPARSE_ERROR;
+            return true;
+        }
+
+        if ((len > 0) && (PARAM_MARK == seg[0])) {
+            if (NULL == node->param) {
+                node->param = uparse_build_node_new(NULL,0);
+                if (NULL == node->param) {
+                    fprintf(stderr,"cannot allocate route node\n");
+                    return false;
+                }
+            }
+            node = node->param;
+            continue;
+        }
+
+        for (size_t i = 0; i < len; i++) {
+            if (0 == (router->classes[(unsigned char) seg[i]] & UPARSE_CLASS_PATH)) {
+                fprintf(stderr,"pattern %s has invalid char '%c'\n",pattern,seg[i]);
+                return false;
+            }
+        }
+
+        node = uparse_build_node_child(node,seg,len);
+        if (NULL == node) {
+            fprintf(stderr,"cannot allocate route node\n");
+            return false;
+        }
+    }
+
+    if (NO_ROUTE_ID != node->route_id) {
+        fprintf(stderr,"pattern %s is already routed\n",pattern);
+        return false;
+    }
+    node->route_id = route_id;
+    *err_out = NO_UPARSE_ERROR;
+    return true;
+}
+
+static uint32_t compile_node(uparse_router_t *router,uparse_build_node_t const *b) {
+
+    size_t idx = 0;
+    if (!uparse_reserve((void **) &router->nodes,&router->node_cap,&router->node_count,1,sizeof(route_node_t),&idx)) {
+        return NO_NODE;
+    }
+
+    size_t const child_count = b->child_count;
+    uparse_build_node_t const **children = NULL;
+    if (0 != child_count) {
+        children = uparse_build_node_sorted(b);
+        if (NULL == children) {
+            return NO_NODE;
+        }
+    }
+
+    // A node's static edges are found by binary searching their first
+    // segments, so they are laid out together before the subtrees below.
+    size_t first_edge = 0;
+    if (!uparse_reserve((void **) &router->edges,&router->edge_cap,&router->edge_count,child_count,
+                        sizeof(route_edge_t),&first_edge)) {
+        free((void *) children);
+        return NO_NODE;
+    }
+
+    for (size_t k = 0; k < child_count; k++) {
+
+        // Merge the chain of single static children below this one.
+        uparse_build_node_t const *end = children[k];
+        uint32_t seg_count = 1;
+        size_t label_len = end->len;
+        while ((NULL != end->children) && (NULL == end->children->sibling) &&
+               (NULL == end->param) && (NO_ROUTE_ID == end->route_id) &&
+               (NO_ROUTE_ID == end->wildcard_route_id)) {
+            end = end->children;
+            label_len += 1 + end->len;
+            seg_count++;
+        }
+
+        if (!uparse_grow((void **) &router->labels,&router->labels_cap,router->labels_len + label_len,1)) {
+            free((void *) children);
+            return NO_NODE;
+        }
+        uint32_t const label_off = (uint32_t) router->labels_len;
+        uparse_build_node_t const *n = children[k];
+        for (uint32_t s = 0; s < seg_count; s++) {
+            if (0 != s) {
+                router->labels[router->labels_len++] = PATH_DELIM;
+                n = n->children;
+            }
+            memcpy(router->labels + router->labels_len,n->label,n->len);
+            router->labels_len += n->len;
+        }
+
+        uint32_t const child = compile_node(router,end);
+        if (NO_NODE == child) {
+            free((void *) children);
+            return NO_NODE;
+        }
+        route_edge_t *e = &router->edges[first_edge + k];
+        e->label_off = label_off;
+        e->label_len = (uint32_t) label_len;
+        e->first_len = (uint32_t) children[k]->len;
+        e->seg_count = seg_count;
+        e->child     = child;
+    }
+    free((void *) children);
+
+    uint32_t param_child = NO_NODE;
+    if (NULL != b->param) {
+        param_child = compile_node(router,b->param);
+        if (NO_NODE == param_child) {
+            return NO_NODE;
+        }
+    }
+
+    route_node_t *node = &router->nodes[idx];
+    node->first_edge        = (uint32_t) first_edge;
+    node->edge_count        = (uint32_t) child_count;
+    node->param_child       = param_child;
+    node->route_id          = b->route_id;
+    node->wildcard_route_id = b->wildcard_route_id;
+    return (uint32_t) idx;
+}
+
+// Compile the added patterns. After this no more patterns can be added.
+bool uparse_router_compile(uparse_router_t *router,unsigned int *err_out) {
+
+    *err_out = UPARSE_ERROR;
+
+    if ((NULL == router) || router->compiled) {
+        fprintf(stderr,"router is null or already compiled\n");
+        return false;
+    }
+    if (NO_NODE == compile_node(router,router->root)) {
+        fprintf(stderr,"cannot allocate compiled router\n");
+        return false;
+    }
+    uparse_build_node_free(router->root);
+    router->root = NULL;
+    router->compiled = true;
+    *err_out = NO_UPARSE_ERROR;
+    return true;
+}
+
+// Find the static edge out of node whose first segment is seg.
+static route_edge_t const *find_edge(uparse_router_t const *router,route_node_t const *node,
+                                     uparse_span_t const *seg) {
+    size_t lo = node->first_edge;
+    size_t hi = lo + node->edge_count;
+    while (lo < hi) {
+        size_t const mid = lo + ((hi - lo) / 2);
+        route_edge_t const *e = &router->edges[mid];
+        int const cmp = uparse_label_cmp(seg->ptr,seg->len,router->labels + e->label_off,e->first_len);
+        if (0 == cmp) {
+            return e;
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+// Check the segments after the first one of a merged edge.
+static bool edge_rest_matches(uparse_router_t const *router,route_edge_t const *e,
+                              uparse_span_t const *segs,size_t i,size_t seg_count) {
+    if ((i + e->seg_count) > seg_count) {
+        return false;
+    }
+    char const *label = router->labels + e->label_off + e->first_len;
+    char const *const label_end = router->labels + e->label_off + e->label_len;
+    for (uint32_t s = 1; s < e->seg_count; s++) {
+        // Skip the '/' between pieces.
+        label++;
+        char const *piece_end = label;
+        while ((piece_end < label_end) && (PATH_DELIM != piece_end[0])) {
+            piece_end++;
+        }
+        uparse_span_t const *seg = &segs[i + s];
+        if ((seg->len != (size_t) (piece_end - label)) || (0 != memcmp(seg->ptr,label,seg->len))) {
+            return false;
+        }
+        label = piece_end;
+    }
+    return true;
+}
+
+// Match segs[i..] below node. Static segments win over params, and params
+// over wildcards; a failed branch restores the captures it made.
+static bool match_node(uparse_router_t const *router,uint32_t idx,uparse_span_t const *segs,
+                       size_t i,size_t seg_count,uparse_route_match_t *m) {
+
+    route_node_t const *node = &router->nodes[idx];
+
+    if (i == seg_count) {
+        if (NO_ROUTE_ID != node->route_id) {
+            m->route_id = node->route_id;
+            return true;
+        }
+        return false;
+    }
+
+    route_edge_t const *e = find_edge(router,node,&segs[i]);
+    if ((NULL != e) && edge_rest_matches(router,e,segs,i,seg_count) &&
+        match_node(router,e->child,segs,i + e->seg_count,seg_count,m)) {
+        return true;
+    }
+
+    if ((NO_NODE != node->param_child) && (0 != segs[i].len)) {
+        size_t const param_count = m->param_count;
+        m->params[m->param_count++] = segs[i];
+        if (match_node(router,node->param_child,segs,i + 1,seg_count,m)) {
+            return true;
+        }
+        m->param_count = param_count;
+    }
+
+    if (NO_ROUTE_ID != node->wildcard_route_id) {
+        uparse_span_t const *last = &segs[seg_count - 1];
+        m->params[m->param_count].ptr = segs[i].ptr;
+        m->params[m->param_count].len = (size_t) ((last->ptr + last->len) - segs[i].ptr);
+        m->param_count++;
+        m->route_id = node->wildcard_route_id;
+        return true;
+    }
+
+    return false;
+}
+
+// Match path segments, as produced by get_path_segments or the path
+// iterator, against the compiled routes. Wildcard captures assume the
+// segments are in one path string. Returns false if no route matches.
+bool uparse_router_match_segments(uparse_router_t const *router,uparse_span_t const *segs,
+                                  size_t seg_count,uparse_route_match_t *match_out) {
+    match_out->route_id = NO_ROUTE_ID;
+    match_out->param_count = 0;
+    if ((NULL == router) || !router->compiled) {
+        return false;
+    }
+    return match_node(router,0,segs,0,seg_count,match_out);
+}
+
+// Match a path, such as url->path, against the compiled routes.
+bool uparse_router_match(uparse_router_t const *router,char const *path,
+                         uparse_route_match_t *match_out) {
+    uparse_span_t segs[UPARSE_ROUTE_MAX_SEGMENTS];
+    size_t overflow = 0;
+    unsigned int err = NO_UPARSE_ERROR;
+    if (NULL == router) {
+        match_out->route_id = NO_ROUTE_ID;
+        match_out->param_count = 0;
+        return false;
+    }
+    size_t const seg_count = get_path_segments_ex(path,segs,UPARSE_ROUTE_MAX_SEGMENTS,&overflow,router->policy,&err);
+    if ((NO_UPARSE_ERROR != err) || (0 != overflow)) {
+        match_out->route_id = NO_ROUTE_ID;
+        match_out->param_count = 0;
+        return false;
+    }
+    return uparse_router_match_segments(router,segs,seg_count,match_out);
+}
@@ -0,0 +1,39 @@
+#ifndef UPARSE_ROUTE_H
+#define UPARSE_ROUTE_H
+
+#include "uparse.h"
+
+// most captures a single route can have
+#define UPARSE_ROUTE_MAX_PARAMS   8
+// paths with more segments than this never match
+#define UPARSE_ROUTE_MAX_SEGMENTS 64
+
+#define NO_ROUTE_ID 0
+
+// the result of a match: the id the route was added with, and the spans of
+// the path that its :param and *wildcard segments captured, in pattern order
+typedef struct uparse_route_match_t {
+    unsigned int  route_id;
+    size_t        param_count;
+    uparse_span_t params[UPARSE_ROUTE_MAX_PARAMS];
+} uparse_route_match_t;
+
+// a table of route patterns like "/api/v1/users/:id/orders" or "/static/*rest".
+// add every pattern, then compile once into a radix tree over path segments.
+// a compiled router is read only, so it can be shared between threads.
+// pattern segments and matched paths may have the path chars of a policy,
+// UPARSE_DEFAULT_POLICY unless the router is made with uparse_router_new_ex.
+typedef struct uparse_router_t uparse_router_t;
+
+uparse_router_t *uparse_router_new(void);
+uparse_router_t *uparse_router_new_ex(uparse_policy_t policy);
+void uparse_router_free(uparse_router_t *router);
+bool uparse_router_add(uparse_router_t *router,char const *pattern,unsigned int route_id,
+                       unsigned int *err_out);
+bool uparse_router_compile(uparse_router_t *router,unsigned int *err_out);
+bool uparse_router_match(uparse_router_t const *router,char const *path,
+                         uparse_route_match_t *match_out);
+bool uparse_router_match_segments(uparse_router_t const *router,uparse_span_t const *segs,
+                                  size_t seg_count,uparse_route_match_t *match_out);
+
+#endif